@@ -275,6 +275,12 @@ void flecs_stack_free(
 void flecs_stack_reset(
     ecs_stack_t *stack);
 
+/** Allocate pages up front, so that the stack can hold at least size bytes 
+ * before it allocates new memory. */
+void flecs_stack_reserve(
+    ecs_stack_t *stack,
+    ecs_size_t size);
+
 FLECS_DBG_API
 ecs_stack_cursor_t* flecs_stack_get_cursor(
     ecs_stack_t *stack);
@@ -1164,7 +1170,9 @@ typedef enum ecs_cmd_kind_t {
     EcsCmdEnable,
     EcsCmdDisable,
     EcsCmdEvent,
-    EcsCmdSkip
+    EcsCmdSkip,
+    EcsCmdCoalesced,    /* Skipped because a later command made it redundant */
+    EcsCmdApplied       /* Applied by thread of stage before the merge */
 } ecs_cmd_kind_t;
 
 /* Entity specific metadata for command in queue */
@@ -1203,8 +1211,37 @@ typedef struct ecs_commands_t {
     ecs_vec_t queue;
     ecs_stack_t stack;          /* Temp memory used by deferred commands */
     ecs_sparse_t entries;       /* <entity, op_entry_t> - command batching */
+    int32_t batched_count;      /* Commands in queue that are in entries */
 } ecs_commands_t;
 
+/* Kind of event recorded by tracing */
+typedef enum ecs_trace_kind_t {
+    EcsTraceFrame,                   /* Pipeline ran for a frame */
+    EcsTraceSystem,                  /* System ran on stage */
+    EcsTraceMerge,                   /* Commands of stages were merged */
+    EcsTraceWait,                    /* Thread waited on sync point */
+    EcsTraceRebuild                  /* Pipeline schedule was (re)built */
+} ecs_trace_kind_t;
+
+/* Timestamped event recorded by tracing */
+typedef struct ecs_trace_event_t {
+    uint64_t start;                  /* Start time (ecs_os_now) */
+    uint64_t end;                    /* End time (ecs_os_now) */
+    int64_t frame;                   /* Frame in which event happened */
+    ecs_entity_t system;             /* System for EcsTraceSystem events */
+    ecs_trace_kind_t kind;
+} ecs_trace_event_t;
+
+/* Ring buffer with trace events. Each stage has its own buffer that's only 
+ * written to by the thread that owns the stage, so recording doesn't require
+ * locking. The buffer grows if it can't hold the traced number of frames. */
+typedef struct ecs_trace_buffer_t {
+    ecs_trace_event_t *events;
+    int32_t size;                    /* Number of events that fit in buffer */
+    int32_t count;                   /* Number of events in buffer */
+    int32_t head;                    /* Index of next event to write */
+} ecs_trace_buffer_t;
+
 /** A stage is a context that allows for safely using the API from multiple 
  * threads. Stage pointers can be passed to the world argument of API 
  * operations, which causes the operation to be ran on the stage instead of the
@@ -1222,11 +1259,18 @@ struct ecs_stage_t {
     ecs_commands_t *cmd;
     ecs_commands_t cmd_stack[ECS_MAX_DEFER_STACK];
     int32_t cmd_sp;
+    int32_t cmd_coalesced;           /* Commands coalesced since last merge */
+    int32_t cmd_applied;             /* Commands applied since last merge */
 
     /* Thread context */
     ecs_world_t *thread_ctx;         /* Points to stage when a thread stage */
     ecs_world_t *world;              /* Reference to world */
     ecs_os_thread_t thread;          /* Thread handle (0 if no threading is used) */
+    int32_t cpu;                     /* Cpu the thread is pinned to, -1 if none */
+    int32_t sync_spin;               /* Adaptive spin budget for sync points */
+    ecs_time_t sync_time;            /* Time at which stage arrived at sync point */
+    double node_wait_time;           /* Time waited on systems in parallel ops */
+    ecs_trace_buffer_t trace;        /* Trace events recorded by thread */
 
     /* One-shot actions to be executed after the merge */
     ecs_vec_t post_frame_actions;
@@ -1344,6 +1388,9 @@ struct ecs_world_t {
 
     /* -- Systems -- */
     ecs_entity_t pipeline;           /* Current pipeline */
+    int32_t system_priority_version; /* Incremented when a priority changes */
+    int32_t system_version;          /* Incremented when a system is reinitialized
+                                      * or a phase schedule changes */
 
     /* -- Identifiers -- */
     ecs_hashmap_t aliases;
@@ -1359,14 +1406,24 @@ struct ecs_world_t {
     ecs_os_mutex_t sync_mutex;       /* Mutex for job_cond */
     int32_t workers_running;         /* Number of threads running */
     int32_t workers_waiting;         /* Number of workers waiting on sync */
+    int32_t workers_parked;          /* Number of workers blocked on worker_cond */
+    int32_t main_parked;             /* Is main thread blocked on sync_cond */
+    int32_t sync_generation;         /* Incremented each time workers are signaled */
+    int32_t sync_spin_max;           /* Max iterations to spin before blocking */
     ecs_pipeline_state_t* pq;        /* Pointer to the pipeline for the workers to execute */
     bool workers_use_task_api;       /* Workers are short-lived tasks, not long-running threads */
+    int32_t worker_affinity;         /* Placement of worker threads (ecs_thread_affinity_t) */
+    ecs_size_t worker_arena_size;    /* Command storage reserved by each worker */
 
     /* -- Time management -- */
     ecs_time_t world_start_time;     /* Timestamp of simulation start */
     ecs_time_t frame_start_time;     /* Timestamp of frame start */
     ecs_ftime_t fps_sleep;           /* Sleep time to prevent fps overshoot */
 
+    /* -- Tracing -- */
+    int32_t trace_frames;            /* Number of frames to trace, 0 if disabled */
+    uint64_t trace_start;            /* Timestamp of trace start (ecs_os_now) */
+
     /* -- Metrics -- */
     ecs_world_info_t info;
 
@@ -1932,6 +1989,39 @@ void flecs_commands_push(
 void flecs_commands_pop(
     ecs_stage_t *stage);
 
+/* Remove redundant commands from queue of stage. Only modifies the queue of the
+ * provided stage, and can run on the thread that owns the stage. */
+void flecs_commands_coalesce(
+    ecs_stage_t *stage);
+
+/* Apply commands of stage that don't move entities to another table. Can run
+ * on the thread that owns the stage, after all stages finished enqueueing 
+ * commands and before the queues are merged. */
+void flecs_commands_apply(
+    ecs_world_t *world,
+    ecs_stage_t *stage);
+
+/* Reserve storage for the command queue and command values of stage */
+void flecs_commands_reserve(
+    ecs_stage_t *stage,
+    ecs_size_t size);
+
+/* Return timestamp for trace event, or 0 if tracing is disabled */
+uint64_t flecs_trace_now(
+    const ecs_world_t *world);
+
+/* Record trace event that started at provided timestamp and ends now */
+void flecs_trace_event(
+    ecs_world_t *world,
+    ecs_stage_t *stage,
+    ecs_trace_kind_t kind,
+    ecs_entity_t system,
+    uint64_t start);
+
+/* Free trace events of stage */
+void flecs_trace_fini(
+    ecs_stage_t *stage);
+
 #endif
 
 /**
@@ -8006,6 +8096,10 @@ void flecs_cmd_batch_for_entity(
             next_for_entity *= -1;
         }
 
+        if (cmd->kind == EcsCmdCoalesced || cmd->kind == EcsCmdApplied) {
+            continue;
+        }
+
         /* Check if added id is still valid (like is the parent of a ChildOf 
          * pair still alive), if not run cleanup actions for entity */
         if (id) {
@@ -8106,6 +8200,8 @@ void flecs_cmd_batch_for_entity(
         case EcsCmdDisable:
         case EcsCmdEvent:
         case EcsCmdSkip:
+        case EcsCmdCoalesced:
+        case EcsCmdApplied:
         case EcsCmdModifiedNoHook:
             break;
         }
@@ -8199,6 +8295,8 @@ void flecs_cmd_batch_for_entity(
             case EcsCmdDisable:
             case EcsCmdEvent:
             case EcsCmdSkip:
+            case EcsCmdCoalesced:
+            case EcsCmdApplied:
                 break;
             }
         } while ((cur = next_for_entity));
@@ -8246,8 +8344,11 @@ bool flecs_defer_end(
                 ecs_entity_t e = cmd->entity;
                 bool is_alive = flecs_entities_is_alive(world, e);
 
-                /* A negative index indicates the first command for an entity */
-                if (merge_to_world && (cmd->next_for_entity < 0)) {
+                /* A negative index indicates the first command for an entity. 
+                 * Commands of an entity are either all applied or none are. */
+                if (merge_to_world && (cmd->next_for_entity < 0) &&
+                    cmd->kind != EcsCmdApplied)
+                {
                     /* Batch commands for entity to limit archetype moves */
                     if (is_alive) {
                         flecs_cmd_batch_for_entity(world, &diff, e, cmds, i);
@@ -8265,6 +8366,13 @@ bool flecs_defer_end(
                  * contained both a delete and a subsequent add/remove/set which
                  * should be ignored. */
                 ecs_cmd_kind_t kind = cmd->kind;
+                if (kind == EcsCmdCoalesced || kind == EcsCmdApplied) {
+                    /* Counted by coalesced_count or applied_count, not as 
+                     * discarded */
+                    flecs_discard_cmd(world, cmd);
+                    continue;
+                }
+
                 if ((kind != EcsCmdPath) && ((kind == EcsCmdSkip) || (e && !is_alive))) {
                     world->info.cmd.discard_count ++;
                     flecs_discard_cmd(world, cmd);
@@ -8374,6 +8482,8 @@ bool flecs_defer_end(
                     break;
                 }
                 case EcsCmdSkip:
+                case EcsCmdCoalesced:
+                case EcsCmdApplied:
                     break;
                 }
 
@@ -8384,8 +8494,14 @@ bool flecs_defer_end(
 
             flecs_stack_reset(&commands->stack);
             ecs_vec_clear(queue);
+            commands->batched_count = 0;
             flecs_commands_pop(stage);
 
+            world->info.cmd.coalesced_count += stage->cmd_coalesced;
+            stage->cmd_coalesced = 0;
+            world->info.cmd.applied_count += stage->cmd_applied;
+            stage->cmd_applied = 0;
+
             flecs_table_diff_builder_fini(world, &diff);
         }
 
@@ -8418,6 +8534,7 @@ bool flecs_defer_purge(
             ecs_vec_clear(&commands);
             flecs_stack_reset(&stage->cmd->stack);
             flecs_sparse_clear(&stage->cmd->entries);
+            stage->cmd->batched_count = 0;
         }
 
         return true;
@@ -13997,6 +14114,119 @@ error:
     return false;
 }
 
+ecs_iter_t ecs_chunk_iter(
+    const ecs_iter_t *it,
+    int32_t *cursor,
+    int32_t size)
+{
+    ecs_check(it != NULL, ECS_INVALID_PARAMETER, NULL);
+    ecs_check(it->next != NULL, ECS_INVALID_PARAMETER, NULL);
+    ecs_check(cursor != NULL, ECS_INVALID_PARAMETER, NULL);
+    ecs_check(size > 0, ECS_INVALID_PARAMETER, NULL);
+
+    ecs_iter_t result = *it;
+    result.priv.cache.stack_cursor = NULL; /* Don't copy allocator cursor */
+    
+    result.priv.iter.chunk = (ecs_chunk_iter_t){
+        .cursor = cursor,
+        .size = size
+    };
+    result.next = ecs_chunk_next;
+    result.fini = ecs_chained_iter_fini;
+    result.chain_it = ECS_CONST_CAST(ecs_iter_t*, it);
+
+    return result;
+error:
+    return (ecs_iter_t){ 0 };
+}
+
+static
+bool ecs_chunk_next_instanced(
+    ecs_iter_t *it)
+{
+    ecs_check(it != NULL, ECS_INVALID_PARAMETER, NULL);
+    ecs_check(it->chain_it != NULL, ECS_INVALID_PARAMETER, NULL);
+    ecs_check(it->next == ecs_chunk_next, ECS_INVALID_PARAMETER, NULL);
+
+    bool instanced = ECS_BIT_IS_SET(it->flags, EcsIterIsInstanced);
+
+    ecs_iter_t *chain_it = it->chain_it;
+    ecs_chunk_iter_t *iter = &it->priv.iter.chunk;
+    int32_t size = iter->size;
+
+    /* Chunks are numbered in the order in which the source iterator returns
+     * results, which is the same for all resources. Skip results until the
+     * one that contains the claimed chunk. */
+    int32_t claimed = ecs_os_ainc(iter->cursor) - 1;
+    while (claimed >= (iter->first + iter->count)) {
+        iter->first += iter->count;
+        iter->count = 0;
+        iter->offset = 0;
+
+        if (!ecs_iter_next(chain_it)) {
+            return false;
+        }
+
+        /* Results without entities are claimed as a single chunk */
+        int32_t count = chain_it->count;
+        iter->count = count ? ((count - 1) / size) + 1 : 1;
+    }
+
+    /* Copy everything up to the private iterator data */
+    ecs_os_memcpy(it, chain_it, offsetof(ecs_iter_t, priv));
+
+    /* Keep instancing setting from original iterator */
+    ECS_BIT_COND(it->flags, EcsIterIsInstanced, instanced);
+
+    if (!it->count) {
+        return true;
+    }
+
+    int32_t first = (claimed - iter->first) * size;
+    int32_t count = ECS_MIN(size, it->count - first);
+    int32_t offset = it->offset + first;
+
+    it->instance_count = count;
+    it->frame_offset += first;
+
+    /* Field pointers are shared with the source iterator, and still have the
+     * offset of the previous chunk claimed from the same result. */
+    flecs_offset_iter(it, offset - iter->offset);
+    if (chain_it->entities) {
+        it->entities = &chain_it->entities[offset];
+    }
+    iter->offset = offset;
+    it->count = count;
+
+    if (ECS_BIT_IS_SET(it->flags, EcsIterIsInstanced)) {
+        it->offset += first;
+    } else {
+        it->offset = 0;
+    }
+
+    return true;
+error:
+    return false;
+}
+
+bool ecs_chunk_next(
+    ecs_iter_t *it)
+{
+    ecs_check(it != NULL, ECS_INVALID_PARAMETER, NULL);
+    ecs_check(it->next == ecs_chunk_next, ECS_INVALID_PARAMETER, NULL);
+    ecs_check(it->chain_it != NULL, ECS_INVALID_PARAMETER, NULL);
+
+    ECS_BIT_SET(it->chain_it->flags, EcsIterIsInstanced);
+
+    if (flecs_iter_next_row(it)) {
+        return true;
+    }
+
+    return flecs_iter_next_instanced(it, ecs_chunk_next_instanced(it));
+error:
+    return false;
+}
+
 /**
  * @file misc.c
  * @brief Miscellaneous functions.
@@ -17168,6 +17398,11 @@ bool ecs_os_has_task_support(void) {
         (ecs_os_api.task_join_ != NULL);
 }
 
+bool ecs_os_has_affinity(void) {
+    return
+        (ecs_os_api.thread_set_affinity_ != NULL);
+}
+
 bool ecs_os_has_time(void) {
     return 
         (ecs_os_api.get_time_ != NULL) &&
@@ -20684,6 +20919,7 @@ ecs_cmd_t* flecs_cmd_new_batched(
 
     int32_t cur = ecs_vec_count(cmds);
     ecs_cmd_t *cmd = flecs_cmd_new(stage);
+    stage->cmd->batched_count ++;
     if (entry) {
         if (entry->first == -1) {
             /* Existing but invalidated entry */
@@ -20728,6 +20964,8 @@ void flecs_stages_merge(
         ecs_os_get_time(&t_start);
     }
 
+    uint64_t trace_start = flecs_trace_now(world);
+
     ecs_dbg_3("#[magenta]merge");
     ecs_log_push_3();
 
@@ -20759,6 +20997,10 @@ void flecs_stages_merge(
         world->info.merge_time_total += (ecs_ftime_t)ecs_time_measure(&t_start);
     }
 
+    if (trace_start) {
+        flecs_trace_event(world, stage, EcsTraceMerge, 0, trace_start);
+    }
+
     world->info.merge_count_total ++; 
 
     /* If stage is asynchronous, deferring is always enabled */
@@ -21254,6 +21496,277 @@ void flecs_commands_pop(
     stage->cmd = &stage->cmd_stack[sp];
 }
 
+/* Returns whether a command for another id can be moved past when looking for
+ * a command to coalesce with. Commands that affect the entity as a whole could
+ * observe the earlier command, so they end the search. */
+static
+bool flecs_cmd_is_independent(
+    ecs_cmd_kind_t kind)
+{
+    switch(kind) {
+    case EcsCmdAdd:
+    case EcsCmdRemove:
+    case EcsCmdSet:
+    case EcsCmdEmplace:
+    case EcsCmdMut:
+    case EcsCmdModified:
+    case EcsCmdModifiedNoHook:
+    case EcsCmdAddModified:
+    case EcsCmdSkip:
+    case EcsCmdCoalesced:
+    case EcsCmdApplied:
+        return true;
+    case EcsCmdClone:
+    case EcsCmdBulkNew:
+    case EcsCmdPath:
+    case EcsCmdDelete:
+    case EcsCmdClear:
+    case EcsCmdOnDeleteAction:
+    case EcsCmdEnable:
+    case EcsCmdDisable:
+    case EcsCmdEvent:
+        return false;
+    }
+    return false;
+}
+
+static
+int32_t flecs_cmd_next_for_entity(
+    const ecs_cmd_t *cmd)
+{
+    int32_t next = cmd->next_for_entity;
+    if (next < 0) {
+        /* First command for an entity has a negative index, flip sign */
+        next *= -1;
+    }
+    return next;
+}
+
+/* Coalesce commands of a single entity. A set that is followed by another set
+ * for the same component is skipped, as the value of the last set is the value
+ * the component ends up with. An add that is followed by a remove for the same
+ * component is skipped, as the component would be removed again. */
+static
+int32_t flecs_cmd_coalesce_for_entity(
+    ecs_cmd_t *cmds,
+    int32_t start)
+{
+    int32_t coalesced = 0, cur = start;
+    do {
+        ecs_cmd_t *cmd = &cmds[cur];
+        ecs_cmd_kind_t kind = cmd->kind;
+        cur = flecs_cmd_next_for_entity(cmd);
+
+        if (kind != EcsCmdSet && kind != EcsCmdAddModified && 
+            kind != EcsCmdAdd) 
+        {
+            continue;
+        }
+
+        int32_t later = cur;
+        while (later) {
+            ecs_cmd_t *later_cmd = &cmds[later];
+            ecs_cmd_kind_t later_kind = later_cmd->kind;
+            later = flecs_cmd_next_for_entity(later_cmd);
+
+            if (later_kind == EcsCmdSkip || later_kind == EcsCmdCoalesced) {
+                continue;
+            }
+
+            if (later_cmd->id == cmd->id) {
+                bool redundant;
+                if (kind == EcsCmdAdd) {
+                    redundant = later_kind == EcsCmdRemove;
+                } else {
+                    redundant = later_kind == EcsCmdSet || 
+                        later_kind == EcsCmdAddModified;
+                }
+
+                if (redundant) {
+                    /* Value of skipped set is freed when the queue is merged */
+                    cmd->kind = EcsCmdCoalesced;
+                    coalesced ++;
+                }
+                break;
+            }
+
+            if (!flecs_cmd_is_independent(later_kind)) {
+                break;
+            }
+        }
+    } while (cur);
+
+    return coalesced;
+}
+
+void flecs_commands_coalesce(
+    ecs_stage_t *stage)
+{
+    ecs_vec_t *queue = &stage->cmd->queue;
+    ecs_cmd_t *cmds = ecs_vec_first_t(queue, ecs_cmd_t);
+    int32_t i, count = ecs_vec_count(queue);
+
+    for (i = 0; i < count; i ++) {
+        /* Only entities with more than one command have a first command with 
+         * a negative index */
+        if (cmds[i].next_for_entity < 0) {
+            stage->cmd_coalesced += flecs_cmd_coalesce_for_entity(cmds, i);
+        }
+    }
+}
+
+/* Returns whether a command leaves the entity in its table and doesn't invoke
+ * hooks. Adding an id the entity already has doesn't do anything, and the value
+ * of a set for a component the entity already has is written when the command
+ * is enqueued, which leaves an AddModified command. */
+static
+bool flecs_cmd_is_applicable(
+    ecs_world_t *world,
+    ecs_table_t *table,
+    const ecs_cmd_t *cmd)
+{
+    const ecs_table_record_t *tr;
+    switch(cmd->kind) {
+    case EcsCmdCoalesced:
+        return true;
+    case EcsCmdAdd:
+        return flecs_table_record_get(world, table, cmd->id) != NULL;
+    case EcsCmdAddModified:
+    case EcsCmdModified:
+    case EcsCmdModifiedNoHook:
+        tr = flecs_table_record_get(world, table, cmd->id);
+        if (!tr || tr->column == -1) {
+            return false;
+        }
+        return table->data.columns[tr->column].ti->hooks.on_set == NULL;
+    case EcsCmdClone:
+    case EcsCmdBulkNew:
+    case EcsCmdRemove:
+    case EcsCmdSet:
+    case EcsCmdEmplace:
+    case EcsCmdMut:
+    case EcsCmdPath:
+    case EcsCmdDelete:
+    case EcsCmdClear:
+    case EcsCmdOnDeleteAction:
+    case EcsCmdEnable:
+    case EcsCmdDisable:
+    case EcsCmdEvent:
+    case EcsCmdSkip:
+    case EcsCmdApplied:
+        return false;
+    }
+    return false;
+}
+
+/* Apply commands of a single entity if they are all applicable, and no other
+ * stage has commands for the entity. This partitions entities between stages,
+ * so that each entity is applied by a single thread, and the order in which
+ * commands for the entity are merged doesn't change. */
+static
+int32_t flecs_cmd_apply_for_entity(
+    ecs_world_t *world,
+    ecs_stage_t *stage,
+    ecs_cmd_t *cmds,
+    int32_t start)
+{
+    ecs_entity_t e = cmds[start].entity;
+    int32_t i, stage_count = world->stage_count;
+    for (i = 0; i < stage_count; i ++) {
+        ecs_stage_t *other = &world->stages[i];
+        if (other == stage) {
+            continue;
+        }
+
+        ecs_cmd_entry_t *entry = flecs_sparse_get_any_t(
+            &other->cmd->entries, ecs_cmd_entry_t, e);
+        if (entry && entry->first != -1) {
+            return 0;
+        }
+    }
+
+    if (!flecs_entities_is_alive(world, e)) {
+        return 0;
+    }
+
+    /* Table doesn't change, so OnSet observers are the only ones that could be
+     * invoked by the commands */
+    ecs_table_t *table = flecs_entities_get(world, e)->table;
+    if (!table || (table->flags & EcsTableHasOnSet)) {
+        return 0;
+    }
+
+    int32_t cur = start;
+    do {
+        if (!flecs_cmd_is_applicable(world, table, &cmds[cur])) {
+            return 0;
+        }
+    } while ((cur = flecs_cmd_next_for_entity(&cmds[cur])));
+
+    int32_t applied = 0;
+    cur = start;
+    do {
+        ecs_cmd_t *cmd = &cmds[cur];
+        cur = flecs_cmd_next_for_entity(cmd);
+        if (cmd->kind == EcsCmdCoalesced) {
+            continue;
+        }
+
+        /* Other stages can apply commands for entities in the same table, so
+         * update change tracking state atomically */
+        if (cmd->kind != EcsCmdAdd && table->dirty_state) {
+            const ecs_table_record_t *tr = flecs_table_record_get(
+                world, table, cmd->id);
+            ecs_os_ainc(&table->dirty_state[tr->column + 1]);
+        }
+
+        cmd->kind = EcsCmdApplied;
+        applied ++;
+    } while (cur);
+
+    return applied;
+}
+
+void flecs_commands_apply(
+    ecs_world_t *world,
+    ecs_stage_t *stage)
+{
+    /* Commands that aren't batched, like delete, clone and events, aren't 
+     * tracked per entity, so it's not known which entities they affect */
+    int32_t i, stage_count = world->stage_count;
+    for (i = 0; i < stage_count; i ++) {
+        ecs_commands_t *commands = world->stages[i].cmd;
+        if (ecs_vec_count(&commands->queue) != commands->batched_count) {
+            return;
+        }
+    }
+
+    ecs_vec_t *queue = &stage->cmd->queue;
+    ecs_cmd_t *cmds = ecs_vec_first_t(queue, ecs_cmd_t);
+    int32_t count = ecs_vec_count(queue);
+
+    for (i = 0; i < count; i ++) {
+        /* Only the first command for an entity has an entry */
+        if (cmds[i].entry) {
+            stage->cmd_applied += flecs_cmd_apply_for_entity(
+                world, stage, cmds, i);
+        }
+    }
+}
+
+void flecs_commands_reserve(
+    ecs_stage_t *stage,
+    ecs_size_t size)
+{
+    /* Split storage evenly between queue and values. Both are cleared instead
+     * of freed after a merge, so the reserved memory is reused each frame. */
+    ecs_commands_t *cmd = &stage->cmd_stack[0];
+    int32_t cmd_count = (size / 2) / ECS_SIZEOF(ecs_cmd_t);
+    ecs_vec_set_min_size_t(&stage->allocator, &cmd->queue, ecs_cmd_t, 
+        cmd_count);
+    flecs_stack_reserve(&cmd->stack, size / 2);
+}
+
 void flecs_stage_init(
     ecs_world_t *world,
     ecs_stage_t *stage)
@@ -21265,6 +21778,7 @@ void flecs_stage_init(
     stage->thread_ctx = world;
     stage->auto_merge = true;
     stage->async = false;
+    stage->cpu = -1;
 
     flecs_stack_init(&stage->allocators.iter_stack);
     flecs_stack_init(&stage->allocators.deser_stack);
@@ -21308,6 +21822,68 @@ void flecs_stage_fini(
     flecs_stack_fini(&stage->allocators.deser_stack);
     flecs_ballocator_fini(&stage->allocators.cmd_entry_chunk);
     flecs_allocator_fini(&stage->allocator);
+    flecs_trace_fini(stage);
+}
+
+uint64_t flecs_trace_now(
+    const ecs_world_t *world)
+{
+    if (!world->trace_frames) {
+        return 0;
+    }
+    return ecs_os_now();
+}
+
+void flecs_trace_event(
+    ecs_world_t *world,
+    ecs_stage_t *stage,
+    ecs_trace_kind_t kind,
+    ecs_entity_t system,
+    uint64_t start)
+{
+    ecs_trace_buffer_t *buf = &stage->trace;
+    int64_t frame = world->info.frame_count_total;
+
+    if (buf->count == buf->size) {
+        /* Buffer is full, so head points to the oldest event. Overwrite it if 
+         * it's older than the traced frames, otherwise grow the buffer. */
+        if (buf->size && buf->events[buf->head].frame <= 
+            (frame - world->trace_frames)) 
+        {
+            buf->count --;
+        } else {
+            int32_t size = ECS_MAX(buf->size * 2, 256);
+            ecs_trace_event_t *events = ecs_os_malloc_n(ecs_trace_event_t, size);
+            int32_t tail = buf->size - buf->head;
+            if (buf->size) {
+                ecs_os_memcpy_n(events, &buf->events[buf->head], 
+                    ecs_trace_event_t, tail);
+                ecs_os_memcpy_n(&events[tail], buf->events, 
+                    ecs_trace_event_t, buf->head);
+            }
+            ecs_os_free(buf->events);
+            buf->events = events;
+            buf->head = buf->count;
+            buf->size = size;
+        }
+    }
+
+    ecs_trace_event_t *event = &buf->events[buf->head];
+    event->start = start;
+    event->end = ecs_os_now();
+    event->frame = frame;
+    event->system = system;
+    event->kind = kind;
+
+    buf->head = (buf->head + 1) % buf->size;
+    buf->count ++;
+}
+
+void flecs_trace_fini(
+    ecs_stage_t *stage)
+{
+    ecs_os_free(stage->trace.events);
+    ecs_os_memset_t(&stage->trace, 0, ecs_trace_buffer_t);
 }
 
 void ecs_set_stage_count(
@@ -21918,6 +22494,7 @@ const ecs_entity_t EcsScopeClose =                   FLECS_HI_COMPONENT_ID + 60;
 const ecs_entity_t EcsMonitor =                     FLECS_HI_COMPONENT_ID + 61;
 const ecs_entity_t EcsEmpty =                       FLECS_HI_COMPONENT_ID + 62;
 const ecs_entity_t ecs_id(EcsPipeline) =            FLECS_HI_COMPONENT_ID + 63;
+const ecs_entity_t ecs_id(EcsPhaseSchedule) =       FLECS_HI_COMPONENT_ID + 76;
 const ecs_entity_t EcsOnStart =                     FLECS_HI_COMPONENT_ID + 64;
 const ecs_entity_t EcsPreFrame =                    FLECS_HI_COMPONENT_ID + 65;
 const ecs_entity_t EcsOnLoad =                      FLECS_HI_COMPONENT_ID + 66;
@@ -34026,6 +34603,8 @@ void flecs_world_stats_to_json(
     ECS_COUNTER_APPEND(reply, stats, commands.discard_count, "Commands for already deleted entities");
     ECS_COUNTER_APPEND(reply, stats, commands.batched_entity_count, "Entities with batched commands");
     ECS_COUNTER_APPEND(reply, stats, commands.batched_count, "Number of commands batched");
+    ECS_COUNTER_APPEND(reply, stats, commands.coalesced_count, "Number of commands coalesced");
+    ECS_COUNTER_APPEND(reply, stats, commands.applied_count, "Commands applied by worker threads");
 
     ECS_COUNTER_APPEND(reply, stats, frame.merge_count, "Number of merges (sync points)");
     ECS_COUNTER_APPEND(reply, stats, frame.pipeline_build_count, "Pipeline rebuilds (happen when systems become active/enabled)");
@@ -34133,6 +34712,12 @@ void flecs_pipeline_stats_to_json(
                 time_spent, stats->stats.t, "");
             ECS_GAUGE_APPEND_T(reply, sync_stats, 
                 commands_enqueued, stats->stats.t, "");
+            ECS_GAUGE_APPEND_T(reply, sync_stats, 
+                main_wait_time, stats->stats.t, "");
+            ECS_GAUGE_APPEND_T(reply, sync_stats, 
+                worker_wait_time, stats->stats.t, "");
+            ECS_GAUGE_APPEND_T(reply, sync_stats, 
+                deferred_count, stats->stats.t, "");
 
             ecs_strbuf_list_pop(reply, "}");
             sync_cur ++;
@@ -34973,6 +35558,10 @@ typedef struct ecs_system_t {
     /* Schedule parameters */
     bool multi_threaded;
     bool no_readonly;
+    int32_t chunk_size;             /* Entities per chunk for multi threaded runs */
+    int32_t chunk_cursor;           /* Next chunk to claim by a stage */
+    int32_t chunk_done;             /* Number of stages done with chunks */
+    int32_t priority;               /* Order of system within phase */
 
     int64_t invoke_count;           /* Number of times system is invoked */
     ecs_ftime_t time_spent;         /* Time spent on running system */
@@ -35033,15 +35622,109 @@ typedef struct ecs_pipeline_op_t {
     int32_t offset;             /* Offset in systems vector */
     int32_t count;              /* Number of systems to run before next op */
     double time_spent;          /* Time spent merging commands for sync point */
+    double wait_time;           /* Time main thread waited for workers */
     int64_t commands_enqueued;  /* Number of commands enqueued for sync point */
+    int64_t deferred_count;     /* Number of phases deferred by frame budget */
+    int32_t scan_offset;        /* Index in scan vector of first system */
     bool multi_threaded;        /* Whether systems can be ran multi threaded */
     bool no_readonly;           /* Whether systems are staged or not */
+    bool parallel;              /* Whether systems are scheduled as a graph */
 } ecs_pipeline_op_t;
 
+/** Dependency graph node for a system in a parallel pipeline op.
+ * This type is the element type in the "nodes" vector of a pipeline. Nodes are
+ * stored at the same index as their system in the "systems" vector. */
+typedef struct ecs_pipeline_node_t {
+    int32_t stage;              /* Stage that runs the system */
+    int32_t dep_count;          /* Number of systems that must run before */
+    int32_t wait_count;         /* Number of dependencies that haven't ran yet */
+    int32_t edge_offset;        /* Offset of dependents in edges vector */
+    int32_t edge_count;         /* Number of dependents */
+    double start;               /* Earliest start, used when assigning stages */
+    ecs_ftime_t time_spent;     /* System time spent when stages were assigned */
+} ecs_pipeline_node_t;
+
+/** System in pipeline schedule.
+ * This type is the element type in the "systems" vector of a pipeline. Systems
+ * are resolved when the schedule is built, so that running the pipeline doesn't
+ * need to look up the system object for each system. */
+typedef struct ecs_pipeline_system_t {
+    ecs_entity_t system;        /* System id */
+    ecs_system_t *sys;          /* System object */
+    int32_t phase;              /* Index in phases vector, -1 if no phase */
+} ecs_pipeline_system_t;
+
+/** Phase of systems in pipeline.
+ * This type is the element type in the "phases" vector of a pipeline, and keeps
+ * track of whether systems of the phase run in the current frame. Elements are
+ * never removed, so that indices stay valid for cached schedules. */
+typedef struct ecs_pipeline_phase_t {
+    ecs_entity_t phase;         /* Phase id */
+    int64_t decided_frame;      /* Frame for which skip was last decided */
+    int64_t last_run;           /* Last frame in which the phase ran */
+    int32_t deferrals;          /* Consecutive frames phase was deferred */
+    bool skip;                  /* Skip systems of phase in current frame */
+    bool deferred;              /* Phase is skipped because of frame budget */
+} ecs_pipeline_phase_t;
+
+/** System matched by the pipeline query.
+ * This type is the element type in the "scan" vector of a pipeline. Systems are
+ * stored in pipeline order, and include inactive systems. */
+typedef struct ecs_pipeline_scan_t {
+    ecs_entity_t system;        /* System id */
+    ecs_system_t *sys;          /* System object */
+    uint64_t group;             /* Query group, orders systems by phase */
+    bool active;                /* Whether the system is active */
+} ecs_pipeline_scan_t;
+
+/** Previously built pipeline schedule.
+ * This type is the element type in the "schedules" vector of a pipeline, and
+ * allows for switching between sets of enabled systems without a rebuild. */
+typedef struct ecs_pipeline_schedule_t {
+    uint64_t hash;              /* Hash of scan */
+    uint64_t match_key;         /* Key of matched systems, 0 if unknown */
+    ecs_vec_t matched;          /* Matched tables and systems, checks key */
+    int32_t priority_version;   /* Priority version systems were ordered for */
+    ecs_vec_t scan;             /* Systems the schedule was built for */
+    ecs_vec_t ops;
+    ecs_vec_t systems;
+    ecs_vec_t nodes;
+    ecs_vec_t edges;
+    int32_t node_stage_count;
+} ecs_pipeline_schedule_t;
+
+/* Number of schedules a pipeline keeps around in addition to the current one */
+#define FLECS_PIPELINE_SCHEDULE_CACHE_SIZE (8)
+
 struct ecs_pipeline_state_t {
     ecs_query_t *query;         /* Pipeline query */
+    ecs_vec_t scan;             /* Systems matched by pipeline query */
+    uint64_t scan_hash;         /* Hash of scan, identifies schedule */
+    uint64_t match_key;         /* Key of matched systems, 0 if unknown */
+    ecs_vec_t matched;          /* Matched tables and systems, checks key */
+    ecs_vec_t match_next;       /* Matched tables and systems of last build */
     ecs_vec_t ops;              /* Pipeline schedule */
-    ecs_vec_t systems;          /* Vector with system ids */
+    ecs_vec_t systems;          /* Vector with systems to run */
+    ecs_vec_t nodes;            /* Dependency graph nodes for systems */
+    ecs_vec_t edges;            /* Indices of dependent systems */
+    int32_t node_stage_count;   /* Stage count for which graph was built */
+    ecs_vec_t wait_times;       /* Time stages waited, per op per stage */
+    int32_t wait_stage_count;   /* Stage count for wait_times */
+    bool parallel_systems;      /* Schedule non-conflicting systems in parallel */
+    bool order_by_priority;     /* Order systems by priority, not by query */
+    bool coalesce_commands;     /* Coalesce commands of stage before merge */
+    bool parallel_merge;        /* Apply commands on workers before merge */
+    bool applying;              /* Workers apply commands instead of systems */
+    ecs_vec_t phases;           /* Phases of systems in pipeline */
+    ecs_map_t phase_index;      /* Map from phase id to index in phases */
+    ecs_ftime_t frame_budget;   /* Time pipeline may spend in frame */
+    ecs_time_t frame_start;     /* Start of current frame, for frame budget */
+    bool phase_scheduling;      /* Whether phases can be skipped this frame */
+    bool phase_lazy;            /* Decide phases when their first system runs */
+    int32_t priority_version;   /* Priority version systems were ordered for */
+    int32_t system_version;     /* System version schedules were built for */
+    ecs_vec_t schedules;        /* Cache with previously built schedules */
+    int32_t schedule_evict;     /* Next cached schedule to replace */
 
     ecs_entity_t last_system;   /* Last system ran by pipeline */
     ecs_id_record_t *idr_inactive; /* Cached record for quick inactive test */
@@ -35057,6 +35740,52 @@ struct ecs_pipeline_state_t {
     bool no_readonly;           /* Is pipeline in readonly mode */
 };
 
+/* Fraction of the frame budget by which each next priority class of a phase
+ * is deferred earlier. Class 1 is deferred when the budget is used up. */
+#define FLECS_PIPELINE_CLASS_STEP (0.125)
+
+/* Number of consecutive frames a phase can be deferred. The next frame it runs
+ * regardless of the budget, so that phases aren't starved by a busy frame. */
+#define FLECS_PIPELINE_MAX_DEFERRALS (4)
+
+/* Number of iterations to spin on a dependency before sleeping */
+#define FLECS_PIPELINE_NODE_SPIN (1000)
+
+/* Minimum cost of a system when assigning systems to stages, in seconds. Keeps
+ * systems that took no measurable time from all landing on the same stage. */
+#define FLECS_PIPELINE_NODE_MIN_COST (1e-7)
+
+/* Hint to the CPU that the thread is in a spin loop */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define flecs_spin_pause() __builtin_ia32_pause()
+#elif defined(__GNUC__) && defined(__aarch64__)
+#define flecs_spin_pause() __asm__ __volatile__("yield")
+#else
+#define flecs_spin_pause()
+#endif
+
+/* Load value with acquire semantics. Writes that another thread made before it
+ * changed the value with an OS API atomic operation are visible after the load
+ * observes the change. */
+#if defined(__GNUC__)
+#define flecs_atomic_load(ptr) __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+/* Compare exchange with equal values never modifies the value */
+#define flecs_atomic_load(ptr)\
+    ((int32_t)_InterlockedCompareExchange((volatile long*)(ptr), 0, 0))
+#else
+static
+int32_t flecs_atomic_load(
+    int32_t *ptr)
+{
+    int32_t value = *(volatile int32_t*)ptr;
+    int32_t barrier = 0;
+    ecs_os_ainc(&barrier); /* OS API atomics are full barriers */
+    return value;
+}
+#endif
+
 typedef struct EcsPipeline {
     /* Stable ptr so threads can safely access while entity/components move */
     ecs_pipeline_state_t *state;
@@ -35104,6 +35833,11 @@ void flecs_signal_workers(
 void flecs_wait_for_sync(
     ecs_world_t *world);
 
+void flecs_record_sync_wait(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    ecs_ftime_t main_wait_time);
+
 #endif
 
 #endif
@@ -35403,6 +36137,8 @@ void ecs_world_stats_get(
     ECS_COUNTER_RECORD(&s->commands.discard_count, t, world->info.cmd.discard_count);
     ECS_COUNTER_RECORD(&s->commands.batched_entity_count, t, world->info.cmd.batched_entity_count);
     ECS_COUNTER_RECORD(&s->commands.batched_count, t, world->info.cmd.batched_command_count);
+    ECS_COUNTER_RECORD(&s->commands.coalesced_count, t, world->info.cmd.coalesced_count);
+    ECS_COUNTER_RECORD(&s->commands.applied_count, t, world->info.cmd.applied_count);
 
     int64_t outstanding_allocs = ecs_os_api_malloc_count + 
         ecs_os_api_calloc_count - ecs_os_api_free_count;
@@ -35604,6 +36340,50 @@ void ecs_system_stats_copy_last(
 
 #ifdef FLECS_PIPELINE
 
+/* Copy time stages waited on sync point, return total for workers */
+static
+double flecs_sync_stats_wait_get(
+    ecs_sync_stats_t *el,
+    const ecs_pipeline_state_t *pq,
+    int32_t op_index)
+{
+    int32_t i, stage_count = pq->wait_stage_count;
+    ecs_vec_init_if_t(&el->stage_wait_time, double);
+    if (!stage_count || 
+        ecs_vec_count(&pq->wait_times) < ((op_index + 1) * stage_count)) 
+    {
+        /* No sync point waits recorded */
+        ecs_vec_clear(&el->stage_wait_time);
+        return 0;
+    }
+
+    ecs_vec_set_count_t(NULL, &el->stage_wait_time, double, stage_count);
+    double *dst = ecs_vec_first_t(&el->stage_wait_time, double);
+    double *src = ecs_vec_get_t(&pq->wait_times, double, 
+        op_index * stage_count);
+    ecs_os_memcpy_n(dst, src, double, stage_count);
+
+    double result = 0;
+    for (i = 1; i < stage_count; i ++) {
+        result += src[i];
+    }
+    return result;
+}
+
+static
+void flecs_sync_stats_wait_copy(
+    ecs_sync_stats_t *dst,
+    const ecs_sync_stats_t *src)
+{
+    int32_t count = ecs_vec_count(&src->stage_wait_time);
+    ecs_vec_init_if_t(&dst->stage_wait_time, double);
+    ecs_vec_set_count_t(NULL, &dst->stage_wait_time, double, count);
+    if (count) {
+        ecs_os_memcpy_n(ecs_vec_first_t(&dst->stage_wait_time, double),
+            ecs_vec_first_t(&src->stage_wait_time, double), double, count);
+    }
+}
+
 bool ecs_pipeline_stats_get(
     ecs_world_t *stage,
     ecs_entity_t pipeline,
@@ -35621,28 +36401,19 @@ bool ecs_pipeline_stats_get(
     ecs_pipeline_state_t *pq = pqc->state;
     ecs_assert(pq != NULL, ECS_INTERNAL_ERROR, NULL);
 
-    int32_t sys_count = 0, active_sys_count = 0;
-
-    /* Count number of active systems */
-    ecs_iter_t it = ecs_query_iter(stage, pq->query);
-    while (ecs_query_next(&it)) {
-        if (flecs_id_record_get_table(pq->idr_inactive, it.table) != NULL) {
-            continue;
-        }
-        active_sys_count += it.count;
-    }
+    int32_t sys_count = 0;
 
     /* Count total number of systems in pipeline */
-    it = ecs_query_iter(stage, pq->query);
+    ecs_iter_t it = ecs_query_iter(stage, pq->query);
     while (ecs_query_next(&it)) {
         sys_count += it.count;
     }   
 
-    /* Also count synchronization points */
+    /* The schedule only contains active systems, in the order in which they
+     * run. Also count synchronization points. */
     ecs_vec_t *ops = &pq->ops;
     ecs_pipeline_op_t *op = ecs_vec_first_t(ops, ecs_pipeline_op_t);
-    ecs_pipeline_op_t *op_last = ecs_vec_last_t(ops, ecs_pipeline_op_t);
-    int32_t pip_count = active_sys_count + ecs_vec_count(ops);
+    int32_t pip_count = ecs_vec_count(&pq->systems) + ecs_vec_count(ops);
 
     if (!sys_count) {
         return false;
@@ -35660,27 +36431,20 @@ bool ecs_pipeline_stats_get(
             ecs_vec_set_count_t(NULL, &s->systems, ecs_entity_t, pip_count);
             systems = ecs_vec_first_t(&s->systems, ecs_entity_t);
 
-            /* Populate systems vector, keep track of sync points */
-            it = ecs_query_iter(stage, pq->query);
-            
-            int32_t i, i_system = 0, ran_since_merge = 0;
-            while (ecs_query_next(&it)) {
-                if (flecs_id_record_get_table(pq->idr_inactive, it.table) != NULL) {
-                    continue;
-                }
-
-                for (i = 0; i < it.count; i ++) {
-                    systems[i_system ++] = it.entities[i];
-                    ran_since_merge ++;
-                    if (op != op_last && ran_since_merge == op->count) {
-                        ran_since_merge = 0;
-                        op++;
-                        systems[i_system ++] = 0; /* 0 indicates a merge point */
-                    }
+            /* Populate systems vector from the schedule, with a merge point
+             * after the systems of each op */
+            ecs_pipeline_system_t *sched = ecs_vec_first_t(
+                &pq->systems, ecs_pipeline_system_t);
+            int32_t i, o, i_system = 0, op_count = ecs_vec_count(ops);
+            for (o = 0; o < op_count; o ++) {
+                ecs_pipeline_op_t *cur = &op[o];
+                int32_t last = cur->offset + cur->count;
+                for (i = cur->offset; i < last; i ++) {
+                    systems[i_system ++] = sched[i].system;
                 }
+                systems[i_system ++] = 0; /* 0 indicates a merge point */
             }
 
-            systems[i_system ++] = 0; /* Last merge */
             ecs_assert(pip_count == i_system, ECS_INTERNAL_ERROR, NULL);
         } else {
             ecs_vec_fini_t(NULL, &s->systems, ecs_entity_t);
@@ -35701,6 +36465,11 @@ bool ecs_pipeline_stats_get(
                 ECS_COUNTER_RECORD(&el->time_spent, s->t, cur->time_spent);
                 ECS_COUNTER_RECORD(&el->commands_enqueued, s->t, 
                     cur->commands_enqueued);
+                ECS_COUNTER_RECORD(&el->main_wait_time, s->t, cur->wait_time);
+                ECS_COUNTER_RECORD(&el->worker_wait_time, s->t, 
+                    flecs_sync_stats_wait_get(el, pq, i));
+                ECS_COUNTER_RECORD(&el->deferred_count, s->t, 
+                    cur->deferred_count);
 
                 el->system_count = cur->count;
                 el->multi_threaded = cur->multi_threaded;
@@ -35739,6 +36508,12 @@ void ecs_pipeline_stats_fini(
     }
     ecs_map_fini(&stats->system_stats);
     ecs_vec_fini_t(NULL, &stats->systems, ecs_entity_t);
+
+    int32_t i, sync_count = ecs_vec_count(&stats->sync_points);
+    ecs_sync_stats_t *syncs = ecs_vec_first_t(&stats->sync_points, ecs_sync_stats_t);
+    for (i = 0; i < sync_count; i ++) {
+        ecs_vec_fini_t(NULL, &syncs[i].stage_wait_time, double);
+    }
     ecs_vec_fini_t(NULL, &stats->sync_points, ecs_sync_stats_t);
 }
 
@@ -35763,6 +36538,7 @@ void ecs_pipeline_stats_reduce(
         ecs_sync_stats_t *src_el = &src_syncs[i];
         flecs_stats_reduce(ECS_METRIC_FIRST(dst_el), ECS_METRIC_LAST(dst_el),
             ECS_METRIC_FIRST(src_el), dst->t, src->t);
+        flecs_sync_stats_wait_copy(dst_el, src_el);
         dst_el->system_count = src_el->system_count;
         dst_el->multi_threaded = src_el->multi_threaded;
         dst_el->no_readonly = src_el->no_readonly;
@@ -35795,6 +36571,7 @@ void ecs_pipeline_stats_reduce_last(
         ecs_sync_stats_t *src_el = &src_syncs[i];
         flecs_stats_reduce_last(ECS_METRIC_FIRST(dst_el), ECS_METRIC_LAST(dst_el),
             ECS_METRIC_FIRST(src_el), dst->t, src->t, count);
+        flecs_sync_stats_wait_copy(dst_el, src_el);
         dst_el->system_count = src_el->system_count;
         dst_el->multi_threaded = src_el->multi_threaded;
         dst_el->no_readonly = src_el->no_readonly;
@@ -35848,6 +36625,7 @@ void ecs_pipeline_stats_copy_last(
         ecs_sync_stats_t *src_el = &src_syncs[i];
         flecs_stats_copy_last(ECS_METRIC_FIRST(dst_el), ECS_METRIC_LAST(dst_el),
             ECS_METRIC_FIRST(src_el), dst->t, t_next(src->t));
+        flecs_sync_stats_wait_copy(dst_el, src_el);
         dst_el->system_count = src_el->system_count;
         dst_el->multi_threaded = src_el->multi_threaded;
         dst_el->no_readonly = src_el->no_readonly;
@@ -35922,6 +36700,8 @@ void ecs_world_stats_log(
     flecs_counter_print("discarded commands", t, &s->commands.discard_count);
     flecs_counter_print("batched entities", t, &s->commands.batched_entity_count);
     flecs_counter_print("batched commands", t, &s->commands.batched_count);
+    flecs_counter_print("coalesced commands", t, &s->commands.coalesced_count);
+    flecs_counter_print("applied commands", t, &s->commands.applied_count);
     ecs_trace("");
     
 error:
@@ -39682,6 +40462,26 @@ void flecs_stack_reset(
     stack->tail_cursor = NULL;
 }
 
+void flecs_stack_reserve(
+    ecs_stack_t *stack,
+    ecs_size_t size)
+{
+    ecs_stack_page_t *page = &stack->first;
+    if (!page->data) {
+        page->data = ecs_os_malloc(ECS_STACK_PAGE_SIZE);
+        ecs_os_linc(&ecs_stack_allocator_alloc_count);
+    }
+
+    /* Pages are not freed when the stack is reset, so existing pages count 
+     * towards the reserved size */
+    for (size -= ECS_STACK_PAGE_SIZE; size > 0; size -= ECS_STACK_PAGE_SIZE) {
+        if (!page->next) {
+            page->next = flecs_stack_page_new(page->id);
+        }
+        page = page->next;
+    }
+}
+
 void flecs_stack_init(
     ecs_stack_t *stack)
 {
@@ -57677,6 +58477,18 @@ ecs_os_thread_id_t win_thread_self(void)
     return (ecs_os_thread_id_t)GetCurrentThreadId();
 }
 
+static
+int win_thread_set_affinity(
+    int32_t cpu)
+{
+    /* Affinity masks only address the cpus in the current processor group */
+    if (cpu < 0 || cpu >= (int32_t)(sizeof(DWORD_PTR) * 8)) {
+        return -1;
+    }
+    DWORD_PTR mask = (DWORD_PTR)1 << cpu;
+    return SetThreadAffinityMask(GetCurrentThread(), mask) ? 0 : -1;
+}
+
 static
 int32_t win_ainc(
     int32_t *count) 
@@ -57884,6 +58696,7 @@ void ecs_set_os_api_impl(void) {
     api.thread_new_ = win_thread_new;
     api.thread_join_ = win_thread_join;
     api.thread_self_ = win_thread_self;
+    api.thread_set_affinity_ = win_thread_set_affinity;
     api.task_new_ = win_thread_new;
     api.task_join_ = win_thread_join;
     api.ainc_ = win_ainc;
@@ -57920,6 +58733,12 @@ void ecs_set_os_api_impl(void) {
 
 #include "pthread.h"
 
+#if defined(__linux__)
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #if defined(__APPLE__) && defined(__MACH__)
 #include <mach/mach_time.h>
 #elif defined(__EMSCRIPTEN__)
@@ -57966,6 +58785,102 @@ ecs_os_thread_id_t posix_thread_self(void)
     return (ecs_os_thread_id_t)pthread_self();
 }
 
+#if defined(__linux__)
+static
+int posix_thread_set_affinity(
+    int32_t cpu)
+{
+    if (cpu < 0 || cpu >= 1024) {
+        return -1;
+    }
+#if defined(CPU_SET)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#elif defined(SYS_sched_setaffinity) && !defined(__STRICT_ANSI__)
+    /* cpu_set_t is only available with _GNU_SOURCE, so use the syscall with a
+     * mask of the same size. */
+    unsigned long mask[1024 / (8 * sizeof(unsigned long))] = {0};
+    size_t bits = 8 * sizeof(unsigned long), index = (size_t)cpu;
+    mask[index / bits] |= 1ul << (index % bits);
+    return (int)syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask);
+#else
+    return -1;
+#endif
+}
+
+static
+void posix_read_int(
+    const char *path,
+    int32_t *out)
+{
+    FILE *file;
+    ecs_os_fopen(&file, path, "r");
+    if (file) {
+        int value;
+        if (fscanf(file, "%d", &value) == 1) {
+            *out = value;
+        }
+        fclose(file);
+    }
+}
+
+static
+int32_t posix_cpu_topology(
+    ecs_os_cpu_t *cpus,
+    int32_t count)
+{
+    FILE *file;
+    char online[1024];
+    ecs_os_fopen(&file, "/sys/devices/system/cpu/online", "r");
+    if (!file) {
+        return 0;
+    }
+
+    char *list = fgets(online, ECS_SIZEOF(online), file);
+    fclose(file);
+    if (!list) {
+        return 0;
+    }
+
+    /* List of cpu ranges, e.g. "0-7,16-23" */
+    int32_t result = 0;
+    while (*list >= '0' && *list <= '9') {
+        char *end;
+        int32_t id, first = (int32_t)strtol(list, &end, 10), last = first;
+        if (*end == '-') {
+            last = (int32_t)strtol(end + 1, &end, 10);
+        }
+
+        for (id = first; id <= last; id ++, result ++) {
+            if (result >= count) {
+                continue;
+            }
+
+            char path[128];
+            ecs_os_cpu_t *cpu = &cpus[result];
+            cpu->id = id;
+            cpu->core = id;
+            cpu->package = 0;
+            ecs_os_sprintf(path, 
+                "/sys/devices/system/cpu/cpu%d/topology/core_id", id);
+            posix_read_int(path, &cpu->core);
+            ecs_os_sprintf(path, 
+                "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", id);
+            posix_read_int(path, &cpu->package);
+        }
+
+        if (*end != ',') {
+            break;
+        }
+        list = end + 1;
+    }
+
+    return result;
+}
+#endif
+
 static
 int32_t posix_ainc(
     int32_t *count)
@@ -58221,6 +59136,10 @@ void ecs_set_os_api_impl(void) {
     api.thread_new_ = posix_thread_new;
     api.thread_join_ = posix_thread_join;
     api.thread_self_ = posix_thread_self;
+#if defined(__linux__)
+    api.thread_set_affinity_ = posix_thread_set_affinity;
+    api.cpu_topology_ = posix_cpu_topology;
+#endif
     api.task_new_ = posix_thread_new;
     api.task_join_ = posix_thread_join;
     api.ainc_ = posix_ainc;
@@ -58255,6 +59174,35 @@ void ecs_set_os_api_impl(void) {
 
 #ifdef FLECS_PIPELINE
 
+static
+void flecs_pipeline_schedule_fini(
+    ecs_allocator_t *a,
+    ecs_pipeline_schedule_t *schedule)
+{
+    ecs_vec_fini_t(a, &schedule->matched, uint64_t);
+    ecs_vec_fini_t(a, &schedule->scan, ecs_pipeline_scan_t);
+    ecs_vec_fini_t(a, &schedule->ops, ecs_pipeline_op_t);
+    ecs_vec_fini_t(a, &schedule->systems, ecs_pipeline_system_t);
+    ecs_vec_fini_t(a, &schedule->nodes, ecs_pipeline_node_t);
+    ecs_vec_fini_t(a, &schedule->edges, int32_t);
+}
+
+/* Remove all cached schedules */
+static
+void flecs_pipeline_schedules_clear(
+    ecs_allocator_t *a,
+    ecs_pipeline_state_t *pq)
+{
+    int32_t i, count = ecs_vec_count(&pq->schedules);
+    ecs_pipeline_schedule_t *schedules = ecs_vec_first_t(
+        &pq->schedules, ecs_pipeline_schedule_t);
+    for (i = 0; i < count; i ++) {
+        flecs_pipeline_schedule_fini(a, &schedules[i]);
+    }
+    ecs_vec_clear(&pq->schedules);
+    pq->schedule_evict = 0;
+}
+
 static void flecs_pipeline_free(
     ecs_pipeline_state_t *p) 
 {
@@ -58262,7 +59210,19 @@ static void flecs_pipeline_free(
         ecs_world_t *world = p->query->filter.world;
         ecs_allocator_t *a = &world->allocator;
         ecs_vec_fini_t(a, &p->ops, ecs_pipeline_op_t);
-        ecs_vec_fini_t(a, &p->systems, ecs_entity_t);
+        ecs_vec_fini_t(a, &p->systems, ecs_pipeline_system_t);
+        ecs_vec_fini_t(a, &p->nodes, ecs_pipeline_node_t);
+        ecs_vec_fini_t(a, &p->edges, int32_t);
+        ecs_vec_fini_t(a, &p->wait_times, double);
+        ecs_vec_fini_t(a, &p->scan, ecs_pipeline_scan_t);
+        ecs_vec_fini_t(a, &p->matched, uint64_t);
+        ecs_vec_fini_t(a, &p->match_next, uint64_t);
+
+        flecs_pipeline_schedules_clear(a, p);
+        ecs_vec_fini_t(a, &p->schedules, ecs_pipeline_schedule_t);
+        ecs_vec_fini_t(a, &p->phases, ecs_pipeline_phase_t);
+        ecs_map_fini(&p->phase_index);
+
         ecs_os_free(p->iters);
         ecs_query_fini(p->query);
         ecs_os_free(p);
@@ -58495,119 +59455,802 @@ EcsPoly* flecs_pipeline_term_system(
     return poly;
 }
 
+/* Returns whether term accesses component data, and whether it writes it */
 static
-bool flecs_pipeline_build(
+bool flecs_pipeline_term_access(
+    ecs_term_t *term,
+    bool *is_write)
+{
+    ecs_inout_kind_t inout = term->inout;
+    if (inout == EcsInOutNone || term->oper == EcsNot) {
+        return false;
+    }
+
+    if (inout == EcsInOutDefault) {
+        bool from_any = ecs_term_match_0(term);
+        bool from_this = ecs_term_match_this(term);
+        if (from_any) {
+            /* Same interpretation as flecs_pipeline_check_term: an id without
+             * a source is just passed to the system */
+            return false;
+        } else if (!from_this || !(term->src.flags & EcsSelf)) {
+            inout = EcsIn;
+        } else {
+            inout = EcsInOut;
+        }
+    }
+
+    *is_write = inout != EcsIn;
+    return true;
+}
+
+/* Returns whether two systems can't run at the same time */
+static
+bool flecs_pipeline_systems_conflict(
+    const ecs_system_t *a,
+    const ecs_system_t *b)
+{
+    /* Systems with a custom run callback can access anything */
+    if (a->run || b->run) {
+        return true;
+    }
+
+    const ecs_filter_t *fa = &a->query->filter;
+    const ecs_filter_t *fb = &b->query->filter;
+
+    /* Systems without terms don't declare what they access */
+    if (!fa->term_count || !fb->term_count) {
+        return true;
+    }
+
+    int32_t ta, tb;
+    for (ta = 0; ta < fa->term_count; ta ++) {
+        ecs_term_t *term_a = &fa->terms[ta];
+        bool write_a;
+        if (!flecs_pipeline_term_access(term_a, &write_a)) {
+            continue;
+        }
+
+        for (tb = 0; tb < fb->term_count; tb ++) {
+            ecs_term_t *term_b = &fb->terms[tb];
+            bool write_b;
+            if (!flecs_pipeline_term_access(term_b, &write_b)) {
+                continue;
+            }
+
+            if (!write_a && !write_b) {
+                continue;
+            }
+
+            if (ecs_id_match(term_a->id, term_b->id) ||
+                ecs_id_match(term_b->id, term_a->id))
+            {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+/* Returns whether a system conflicts with a system in the current op, when one
+ * of them uses chunked iteration. Chunks don't assign the same entities to the
+ * same stage for different systems, so such systems need a sync point. */
+static
+bool flecs_pipeline_chunk_conflict(
+    ecs_vec_t *op_systems,
+    ecs_system_t *sys)
+{
+    int32_t i, count = ecs_vec_count(op_systems);
+    ecs_system_t **systems = ecs_vec_first_t(op_systems, ecs_system_t*);
+    for (i = 0; i < count; i ++) {
+        ecs_system_t *other = systems[i];
+        if (!other->chunk_size && !sys->chunk_size) {
+            continue;
+        }
+        if (flecs_pipeline_systems_conflict(other, sys)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Assign each system of a parallel op to the stage on which it can start the
+ * earliest. When measured is true, the cost of a system is the time it spent in
+ * the previous frame, otherwise all systems have the same cost. */
+static
+void flecs_pipeline_assign_stages(
     ecs_world_t *world,
-    ecs_pipeline_state_t *pq)
+    ecs_pipeline_state_t *pq,
+    ecs_pipeline_op_t *op,
+    bool measured)
 {
-    ecs_iter_t it = ecs_query_iter(world, pq->query);
+    int32_t stage_count = pq->node_stage_count;
+    ecs_pipeline_system_t *systems = ecs_vec_first_t(
+        &pq->systems, ecs_pipeline_system_t);
+    ecs_pipeline_node_t *nodes = ecs_vec_first_t(
+        &pq->nodes, ecs_pipeline_node_t);
+    int32_t *edges = ecs_vec_first_t(&pq->edges, int32_t);
+    int32_t i, first = op->offset, last = op->offset + op->count;
 
-    if (pq->match_count == pq->query->match_count) {
-        /* No need to rebuild the pipeline */
-        ecs_iter_fini(&it);
-        return false;
+    double *stage_end = flecs_walloc_n(world, double, stage_count);
+    ecs_os_memset_n(stage_end, 0, double, stage_count);
+    for (i = first; i < last; i ++) {
+        nodes[i].start = 0;
     }
 
-    world->info.pipeline_build_count_total ++;
-    pq->rebuild_count ++;
+    /* Systems are already in topological order, so a single pass is enough to
+     * assign each system to the least loaded stage. */
+    for (i = first; i < last; i ++) {
+        ecs_pipeline_node_t *node = &nodes[i];
+        double cost = 1;
+        if (measured) {
+            ecs_ftime_t time_spent = systems[i].sys->time_spent;
+            cost = ECS_MAX((double)(time_spent - node->time_spent), 
+                FLECS_PIPELINE_NODE_MIN_COST);
+            node->time_spent = time_spent;
+        }
 
+        int32_t s, best = 0;
+        double best_start = 0;
+        for (s = 0; s < stage_count; s ++) {
+            double t = ECS_MAX(stage_end[s], node->start);
+            if (!s || t < best_start) {
+                best_start = t;
+                best = s;
+            }
+        }
+
+        node->stage = best;
+        stage_end[best] = best_start + cost;
+
+        int32_t e;
+        for (e = 0; e < node->edge_count; e ++) {
+            ecs_pipeline_node_t *dep = &nodes[edges[node->edge_offset + e]];
+            dep->start = ECS_MAX(dep->start, stage_end[best]);
+        }
+    }
+
+    flecs_wfree_n(world, double, stage_count, stage_end);
+}
+
+/* Build dependency graph for systems in parallel ops. Systems that conflict get
+ * an edge from the first to the second system, after which each system is
+ * assigned to the stage on which it can start the earliest. Ops before
+ * op_index are not modified, which requires that they were built for the
+ * current number of stages. */
+static
+void flecs_pipeline_build_graph(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    int32_t op_index)
+{
     ecs_allocator_t *a = &world->allocator;
-    ecs_pipeline_op_t *op = NULL;
-    ecs_write_state_t ws = {0};
-    ecs_map_init(&ws.ids, a);
-    ecs_map_init(&ws.wildcard_ids, a);
+    int32_t stage_count = ecs_get_stage_count(world);
+    int32_t system_count = ecs_vec_count(&pq->systems);
+    ecs_pipeline_op_t *ops = ecs_vec_first_t(&pq->ops, ecs_pipeline_op_t);
+    int32_t o, op_count = ecs_vec_count(&pq->ops);
+    int32_t i, j, system_offset = 0, edge_count = 0;
 
-    ecs_vec_reset_t(a, &pq->ops, ecs_pipeline_op_t);
-    ecs_vec_reset_t(a, &pq->systems, ecs_entity_t);
+    ecs_assert(!op_index || pq->node_stage_count == stage_count,
+        ECS_INTERNAL_ERROR, NULL);
 
-    bool multi_threaded = false;
-    bool no_readonly = false;
-    bool first = true;
+    if (op_index) {
+        ecs_pipeline_node_t *nodes = ecs_vec_first_t(
+            &pq->nodes, ecs_pipeline_node_t);
+        system_offset = system_count;
+        if (op_index < op_count) {
+            system_offset = ops[op_index].offset;
+        }
+        for (i = 0; i < system_offset; i ++) {
+            edge_count += nodes[i].edge_count;
+        }
+    }
 
-    /* Iterate systems in pipeline, add ops for running / merging */
+    ecs_vec_set_count_t(a, &pq->edges, int32_t, edge_count);
+    ecs_vec_set_count_t(a, &pq->nodes, ecs_pipeline_node_t, system_count);
+    pq->node_stage_count = stage_count;
+
+    if (system_offset == system_count) {
+        return;
+    }
+
+    ecs_pipeline_node_t *nodes = ecs_vec_first_t(
+        &pq->nodes, ecs_pipeline_node_t);
+    int32_t node_count = system_count - system_offset;
+    ecs_os_memset_n(&nodes[system_offset], 0, ecs_pipeline_node_t, node_count);
+
+    ecs_pipeline_system_t *systems = ecs_vec_first_t(
+        &pq->systems, ecs_pipeline_system_t);
+
+    for (o = op_index; o < op_count; o ++) {
+        ecs_pipeline_op_t *op = &ops[o];
+        int32_t first = op->offset, last = op->offset + op->count;
+
+        op->parallel = stage_count > 1 && op->multi_threaded &&
+            !op->no_readonly && op->count > 1;
+        if (!op->parallel) {
+            continue;
+        }
+
+        for (i = first; i < last; i ++) {
+            nodes[i].edge_offset = ecs_vec_count(&pq->edges);
+            for (j = i + 1; j < last; j ++) {
+                if (flecs_pipeline_systems_conflict(
+                    systems[i].sys, systems[j].sys))
+                {
+                    ecs_vec_append_t(a, &pq->edges, int32_t)[0] = j;
+                    nodes[i].edge_count ++;
+                    nodes[j].dep_count ++;
+                }
+            }
+        }
+
+        /* Without measurements from a previous frame all systems have the
+         * same cost. Take a snapshot of the time spent, so that the next frame
+         * can assign stages by how long systems took in this frame. */
+        for (i = first; i < last; i ++) {
+            nodes[i].time_spent = systems[i].sys->time_spent;
+        }
+
+        flecs_pipeline_assign_stages(world, pq, op, false);
+    }
+}
+
+/* Collect systems matched by the pipeline query in query order */
+static
+void flecs_pipeline_scan(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    ecs_vec_t *scan)
+{
+    ecs_allocator_t *a = &world->allocator;
+    ecs_query_t *query = pq->query;
+
+    /* Groups are iterated in descending order for a descending cascade term.
+     * Invert group ids so that sorting them ascending yields the same order. */
+    uint64_t group_mask = 0;
+    if (query->cascade_by && 
+        (query->filter.terms[query->cascade_by - 1].src.flags & EcsDesc))
+    {
+        group_mask = UINT64_MAX;
+    }
+
+    ecs_iter_t it = ecs_query_iter(world, query);
     while (ecs_query_next(&it)) {
         EcsPoly *poly = flecs_pipeline_term_system(&it);
         bool is_active = ecs_table_get_type_index(world, it.table, EcsEmpty) == -1;
+        uint64_t group = it.group_id ^ group_mask;
 
         int32_t i;
         for (i = 0; i < it.count; i ++) {
             ecs_poly_assert(poly[i].poly, ecs_system_t);
-            ecs_system_t *sys = (ecs_system_t*)poly[i].poly;
-            ecs_query_t *q = sys->query;
+            ecs_pipeline_scan_t *elem = ecs_vec_append_t(
+                a, scan, ecs_pipeline_scan_t);
+            elem->system = it.entities[i];
+            elem->sys = (ecs_system_t*)poly[i].poly;
+            elem->group = group;
+            elem->active = is_active;
+        }
+    }
+}
 
-            bool needs_merge = false;
-            needs_merge = flecs_pipeline_check_terms(
-                world, &q->filter, is_active, &ws);
+/* Return byte of the (group, priority, id) sort key. Byte 0 is the least 
+ * significant byte. The sign bit of the priority is flipped so that negative
+ * priorities are ordered before positive priorities. The group is the cascade
+ * depth for the default pipeline query, but can be any 64 bit value for a
+ * query with a custom group_by callback. */
+static
+uint8_t flecs_pipeline_scan_key(
+    const ecs_pipeline_scan_t *elem,
+    int32_t byte)
+{
+    uint64_t value;
+    if (byte < 8) {
+        value = elem->system;
+    } else if (byte < 12) {
+        value = (uint32_t)elem->sys->priority ^ 0x80000000u;
+        byte -= 8;
+    } else {
+        value = elem->group;
+        byte -= 12;
+    }
+    return (uint8_t)(value >> (byte * 8));
+}
 
-            if (is_active) {
-                if (first) {
-                    multi_threaded = sys->multi_threaded;
-                    no_readonly = sys->no_readonly;
-                    first = false;
-                }
+/* Order systems by group, priority and id. This uses an LSD radix sort that
+ * skips bytes which are the same for all systems. In a typical pipeline that
+ * leaves only a few passes over the low bytes of the ids and group. */
+static
+void flecs_pipeline_scan_sort(
+    ecs_world_t *world,
+    ecs_vec_t *scan)
+{
+    int32_t count = ecs_vec_count(scan);
+    if (count < 2) {
+        return;
+    }
 
-                if (sys->multi_threaded != multi_threaded) {
-                    needs_merge = true;
-                    multi_threaded = sys->multi_threaded;
-                }
-                if (sys->no_readonly != no_readonly) {
-                    needs_merge = true;
-                    no_readonly = sys->no_readonly;
-                }
+    ecs_allocator_t *a = &world->allocator;
+    ecs_pipeline_scan_t *elems = ecs_vec_first_t(scan, ecs_pipeline_scan_t);
+    ecs_pipeline_scan_t *tmp = flecs_alloc_n(a, ecs_pipeline_scan_t, count);
+    ecs_pipeline_scan_t *src = elems, *dst = tmp;
+    int32_t counts[256];
+
+    int32_t byte, i;
+    for (byte = 0; byte < 20; byte ++) {
+        ecs_os_memset(counts, 0, ECS_SIZEOF(counts));
+        for (i = 0; i < count; i ++) {
+            counts[flecs_pipeline_scan_key(&src[i], byte)] ++;
+        }
+
+        if (counts[flecs_pipeline_scan_key(&src[0], byte)] == count) {
+            continue;
+        }
+
+        int32_t offset = 0;
+        for (i = 0; i < 256; i ++) {
+            int32_t n = counts[i];
+            counts[i] = offset;
+            offset += n;
+        }
+
+        for (i = 0; i < count; i ++) {
+            dst[counts[flecs_pipeline_scan_key(&src[i], byte)] ++] = src[i];
+        }
+
+        ecs_pipeline_scan_t *t = src;
+        src = dst;
+        dst = t;
+    }
+
+    if (src != elems) {
+        ecs_os_memcpy_n(elems, src, ecs_pipeline_scan_t, count);
+    }
+
+    flecs_free_n(a, ecs_pipeline_scan_t, count, tmp);
+}
+
+/* Returns a hash of the system ids and whether they're active, which 
+ * identifies the schedule that the pipeline builds for them. */
+static
+uint64_t flecs_pipeline_scan_hash(
+    const ecs_vec_t *scan)
+{
+    uint64_t hash = 14695981039346656037ull; /* FNV-1a */
+    const ecs_pipeline_scan_t *elems = ecs_vec_first_t(
+        scan, ecs_pipeline_scan_t);
+    int32_t i, count = ecs_vec_count(scan);
+    for (i = 0; i < count; i ++) {
+        /* Entity ids don't use the upper bit, which leaves room for the
+         * active flag. */
+        hash ^= (elems[i].system << 1) | elems[i].active;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/* Return index of first system that differs between two scans */
+static
+int32_t flecs_pipeline_scan_diff(
+    const ecs_vec_t *scan_a,
+    const ecs_vec_t *scan_b)
+{
+    const ecs_pipeline_scan_t *a = ecs_vec_first_t(scan_a, ecs_pipeline_scan_t);
+    const ecs_pipeline_scan_t *b = ecs_vec_first_t(scan_b, ecs_pipeline_scan_t);
+    int32_t i, count = ECS_MIN(ecs_vec_count(scan_a), ecs_vec_count(scan_b));
+    for (i = 0; i < count; i ++) {
+        if (a[i].system != b[i].system || a[i].active != b[i].active) {
+            break;
+        }
+    }
+    return i;
+}
+
+static
+bool flecs_pipeline_scan_equal(
+    const ecs_vec_t *scan_a,
+    const ecs_vec_t *scan_b)
+{
+    int32_t count = ecs_vec_count(scan_a);
+    if (count != ecs_vec_count(scan_b)) {
+        return false;
+    }
+    return flecs_pipeline_scan_diff(scan_a, scan_b) == count;
+}
+
+/* Swap current pipeline schedule with cached schedule */
+static
+void flecs_pipeline_schedule_swap(
+    ecs_pipeline_state_t *pq,
+    ecs_pipeline_schedule_t *schedule)
+{
+    ecs_pipeline_schedule_t tmp = {
+        .hash = pq->scan_hash,
+        .match_key = pq->match_key,
+        .matched = pq->matched,
+        .priority_version = pq->priority_version,
+        .scan = pq->scan,
+        .ops = pq->ops,
+        .systems = pq->systems,
+        .nodes = pq->nodes,
+        .edges = pq->edges,
+        .node_stage_count = pq->node_stage_count
+    };
+
+    pq->scan_hash = schedule->hash;
+    pq->match_key = schedule->match_key;
+    pq->matched = schedule->matched;
+    pq->priority_version = schedule->priority_version;
+    pq->scan = schedule->scan;
+    pq->ops = schedule->ops;
+    pq->systems = schedule->systems;
+    pq->nodes = schedule->nodes;
+    pq->edges = schedule->edges;
+    pq->node_stage_count = schedule->node_stage_count;
+
+    *schedule = tmp;
+}
+
+static
+int32_t flecs_pipeline_schedule_find(
+    ecs_pipeline_state_t *pq,
+    uint64_t hash,
+    const ecs_vec_t *scan)
+{
+    ecs_pipeline_schedule_t *schedules = ecs_vec_first_t(
+        &pq->schedules, ecs_pipeline_schedule_t);
+    int32_t i, count = ecs_vec_count(&pq->schedules);
+    for (i = 0; i < count; i ++) {
+        if (schedules[i].hash == hash &&
+            flecs_pipeline_scan_equal(&schedules[i].scan, scan))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static
+bool flecs_pipeline_matched_equal(
+    const ecs_vec_t *matched_a,
+    const ecs_vec_t *matched_b)
+{
+    int32_t count = ecs_vec_count(matched_a);
+    if (count != ecs_vec_count(matched_b)) {
+        return false;
+    }
+    return !count || !ecs_os_memcmp(ecs_vec_first_t(matched_a, uint64_t), 
+        ecs_vec_first_t(matched_b, uint64_t), count * ECS_SIZEOF(uint64_t));
+}
+
+static
+int32_t flecs_pipeline_schedule_find_key(
+    ecs_pipeline_state_t *pq,
+    uint64_t match_key,
+    const ecs_vec_t *matched,
+    int32_t priority_version)
+{
+    ecs_pipeline_schedule_t *schedules = ecs_vec_first_t(
+        &pq->schedules, ecs_pipeline_schedule_t);
+    int32_t i, count = ecs_vec_count(&pq->schedules);
+    for (i = 0; i < count; i ++) {
+        if (schedules[i].match_key == match_key &&
+            schedules[i].priority_version == priority_version &&
+            flecs_pipeline_matched_equal(&schedules[i].matched, matched))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Store the tables and systems matched by the pipeline query in matched, and
+ * return a key for them. This identifies the scan without iterating the query
+ * or sorting systems. For each non-empty table the list has the table id, the
+ * hash of the table type, the group id and the number of systems, followed by
+ * the systems. The type hash tells apart tables that reuse the id of a deleted
+ * table. The key is only valid for pipelines that order by priority, as a 
+ * custom order_by callback can depend on component values. Returns 0 if the 
+ * key can't be used. */
+static
+uint64_t flecs_pipeline_match_key(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    ecs_vec_t *matched)
+{
+    ecs_vec_init_if_t(matched, uint64_t);
+    ecs_vec_clear(matched);
+    if (!pq->order_by_priority) {
+        return 0;
+    }
+
+    ecs_allocator_t *a = &world->allocator;
+    ecs_query_table_match_t *cur = pq->query->list.first;
+    for (; cur; cur = cur->next) {
+        ecs_table_t *table = cur->table;
+        int32_t count = ecs_table_count(table);
+        if (!count) {
+            continue;
+        }
+
+        uint64_t *elem = ecs_vec_grow_t(a, matched, uint64_t, 4 + count);
+        elem[0] = table->id;
+        elem[1] = table->_->hash;
+        elem[2] = cur->group_id;
+        elem[3] = (uint64_t)count;
+        ecs_os_memcpy_n(&elem[4], ecs_vec_first_t(&table->data.entities, 
+            ecs_entity_t), ecs_entity_t, count);
+    }
+
+    uint64_t key = flecs_hash(ecs_vec_first_t(matched, uint64_t), 
+        ecs_vec_count(matched) * ECS_SIZEOF(uint64_t));
+    return key ? key : 1;
+}
+
+/* Use key and matched list of last build for the current schedule */
+static
+void flecs_pipeline_match_set(
+    ecs_pipeline_state_t *pq,
+    uint64_t match_key)
+{
+    ecs_vec_t tmp = pq->matched;
+    pq->matched = pq->match_next;
+    pq->match_next = tmp;
+    pq->match_key = match_key;
+}
+
+/* Add copy of current schedule to the cache, so that the pipeline can switch
+ * back to it without a rebuild. */
+static
+void flecs_pipeline_schedule_store(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq)
+{
+    ecs_allocator_t *a = &world->allocator;
+    ecs_pipeline_schedule_t *schedule;
+    if (ecs_vec_count(&pq->schedules) < FLECS_PIPELINE_SCHEDULE_CACHE_SIZE) {
+        schedule = ecs_vec_append_t(a, &pq->schedules, ecs_pipeline_schedule_t);
+    } else {
+        schedule = ecs_vec_get_t(&pq->schedules, ecs_pipeline_schedule_t,
+            pq->schedule_evict);
+        flecs_pipeline_schedule_fini(a, schedule);
+        pq->schedule_evict = (pq->schedule_evict + 1) %
+            FLECS_PIPELINE_SCHEDULE_CACHE_SIZE;
+    }
+
+    schedule->hash = pq->scan_hash;
+    schedule->match_key = pq->match_key;
+    schedule->matched = ecs_vec_copy_t(a, &pq->matched, uint64_t);
+    schedule->priority_version = pq->priority_version;
+    schedule->scan = ecs_vec_copy_t(a, &pq->scan, ecs_pipeline_scan_t);
+    schedule->ops = ecs_vec_copy_t(a, &pq->ops, ecs_pipeline_op_t);
+    schedule->systems = ecs_vec_copy_t(a, &pq->systems, ecs_pipeline_system_t);
+    schedule->nodes = ecs_vec_copy_t(a, &pq->nodes, ecs_pipeline_node_t);
+    schedule->edges = ecs_vec_copy_t(a, &pq->edges, int32_t);
+    schedule->node_stage_count = pq->node_stage_count;
+}
+
+/* Find first op that's affected by the difference between the current and the
+ * new scan. Ops are built by a single pass over the scan which starts each op
+ * with a clean write state, so ops before it can be reused as is. The first
+ * system of an op decides whether the op starts there, so it must be one of the
+ * systems that didn't change. */
+static
+int32_t flecs_pipeline_resume_op(
+    ecs_pipeline_state_t *pq,
+    const ecs_vec_t *scan)
+{
+    int32_t diff = flecs_pipeline_scan_diff(&pq->scan, scan);
+    ecs_pipeline_op_t *ops = ecs_vec_first_t(&pq->ops, ecs_pipeline_op_t);
+    int32_t i, count = ecs_vec_count(&pq->ops);
+    for (i = count - 1; i > 0; i --) {
+        if (ops[i].scan_offset < diff) {
+            break;
+        }
+    }
+    return ECS_MAX(i, 0);
+}
+
+/* Return index of the phase of a system in the phases vector */
+static
+int32_t flecs_pipeline_phase_index(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    ecs_entity_t system)
+{
+    ecs_entity_t phase = ecs_get_target(world, system, EcsDependsOn, 0);
+    if (!phase) {
+        return -1;
+    }
+
+    /* Map stores index + 1, so that 0 means the phase isn't in the vector */
+    ecs_map_val_t *index = ecs_map_ensure(&pq->phase_index, phase);
+    if (!index[0]) {
+        ecs_pipeline_phase_t *elem = ecs_vec_append_t(&world->allocator, 
+            &pq->phases, ecs_pipeline_phase_t);
+        elem->phase = phase;
+        elem->decided_frame = -1;
+        elem->last_run = INT32_MIN;
+        elem->deferrals = 0;
+        elem->skip = false;
+        elem->deferred = false;
+        index[0] = (ecs_map_val_t)ecs_vec_count(&pq->phases);
+    }
+
+    return flecs_uto(int32_t, index[0] - 1);
+}
+
+/* Return whether the systems of a phase can be deferred by the frame budget */
+static
+bool flecs_pipeline_phase_budgeted(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    int32_t phase)
+{
+    if (pq->frame_budget <= 0 || phase == -1) {
+        return false;
+    }
+
+    ecs_pipeline_phase_t *elem = ecs_vec_get_t(
+        &pq->phases, ecs_pipeline_phase_t, phase);
+    const EcsPhaseSchedule *ps = ecs_get(world, elem->phase, EcsPhaseSchedule);
+    return ps && ps->priority_class > 0;
+}
+
+/* Build pipeline ops from scan, starting from op_index */
+static
+void flecs_pipeline_build_ops(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    int32_t op_index)
+{
+    ecs_allocator_t *a = &world->allocator;
+    ecs_pipeline_op_t *op = NULL;
+    ecs_write_state_t ws = {0};
+    ecs_map_init(&ws.ids, a);
+    ecs_map_init(&ws.wildcard_ids, a);
+
+    ecs_vec_t op_systems; /* Systems in current op */
+    ecs_vec_init_t(a, &op_systems, ecs_system_t*, 0);
+
+    ecs_pipeline_scan_t *scan = ecs_vec_first_t(&pq->scan, ecs_pipeline_scan_t);
+    int32_t scan_count = ecs_vec_count(&pq->scan);
+    int32_t scan_offset = 0, system_offset = 0;
+    if (op_index < ecs_vec_count(&pq->ops)) {
+        ecs_pipeline_op_t *resume = ecs_vec_get_t(
+            &pq->ops, ecs_pipeline_op_t, op_index);
+        scan_offset = resume->scan_offset;
+        system_offset = resume->offset;
+    } else {
+        op_index = 0;
+    }
+
+    ecs_vec_set_count_t(a, &pq->ops, ecs_pipeline_op_t, op_index);
+    ecs_vec_set_count_t(a, &pq->systems, ecs_pipeline_system_t, system_offset);
+
+    bool multi_threaded = false;
+    bool no_readonly = false;
+    bool first = true;
+    int32_t phase = -1;
+
+    /* When resuming, threading mode and phase are inherited from the last
+     * active system of the previous op. */
+    int32_t i;
+    for (i = scan_offset - 1; i >= 0; i --) {
+        if (scan[i].active) {
+            multi_threaded = scan[i].sys->multi_threaded;
+            no_readonly = scan[i].sys->no_readonly;
+            phase = flecs_pipeline_phase_index(world, pq, scan[i].system);
+            first = false;
+            break;
+        }
+    }
+
+    /* Iterate systems in pipeline, add ops for running / merging */
+    for (i = scan_offset; i < scan_count; i ++) {
+        ecs_system_t *sys = scan[i].sys;
+        ecs_query_t *q = sys->query;
+        bool is_active = scan[i].active;
+
+        bool needs_merge = false;
+        needs_merge = flecs_pipeline_check_terms(
+            world, &q->filter, is_active, &ws);
+
+        int32_t sys_phase = -1;
+        if (is_active) {
+            sys_phase = flecs_pipeline_phase_index(world, pq, scan[i].system);
+            if (first) {
+                multi_threaded = sys->multi_threaded;
+                no_readonly = sys->no_readonly;
+                first = false;
             }
 
-            if (no_readonly) {
+            if (sys->multi_threaded != multi_threaded) {
+                needs_merge = true;
+                multi_threaded = sys->multi_threaded;
+            }
+            if (sys->no_readonly != no_readonly) {
                 needs_merge = true;
+                no_readonly = sys->no_readonly;
+            }
+            if (!needs_merge && multi_threaded) {
+                needs_merge = flecs_pipeline_chunk_conflict(
+                    &op_systems, sys);
             }
 
-            if (needs_merge) {
-                /* After merge all components will be merged, so reset state */
-                flecs_pipeline_reset_write_state(&ws);
+            /* Workers run all systems of an op without returning to the main
+             * thread, so whether a phase that can be deferred runs is decided
+             * when the op starts. Start a new op for such a phase, so that the
+             * time spent by earlier phases is known when it's decided. */
+            if (!needs_merge && multi_threaded && sys_phase != phase &&
+                flecs_pipeline_phase_budgeted(world, pq, sys_phase))
+            {
+                needs_merge = true;
+            }
+            phase = sys_phase;
+        }
 
-                /* An inactive system can insert a merge if one of its 
-                 * components got written, which could make the system 
-                 * active. If this is the only system in the pipeline operation,
-                 * it results in an empty operation when we get here. If that's
-                 * the case, reuse the empty operation for the next op. */
-                if (op && op->count) {
-                    op = NULL;
-                }
+        if (no_readonly) {
+            needs_merge = true;
+        }
 
-                /* Re-evaluate columns to set write flags if system is active.
-                 * If system is inactive, it can't write anything and so it
-                 * should not insert unnecessary merges.  */
-                needs_merge = false;
-                if (is_active) {
-                    needs_merge = flecs_pipeline_check_terms(
-                        world, &q->filter, true, &ws);
-                }
+        if (needs_merge) {
+            /* After merge all components will be merged, so reset state */
+            flecs_pipeline_reset_write_state(&ws);
 
-                /* The component states were just reset, so if we conclude that
-                 * another merge is needed something is wrong. */
-                ecs_assert(needs_merge == false, ECS_INTERNAL_ERROR, NULL);        
+            /* An inactive system can insert a merge if one of its
+             * components got written, which could make the system
+             * active. If this is the only system in the pipeline operation,
+             * it results in an empty operation when we get here. If that's
+             * the case, reuse the empty operation for the next op. */
+            if (op && op->count) {
+                op = NULL;
             }
+            ecs_vec_clear(&op_systems);
 
-            if (!op) {
-                op = ecs_vec_append_t(a, &pq->ops, ecs_pipeline_op_t);
-                op->offset = ecs_vec_count(&pq->systems);
-                op->count = 0;
-                op->multi_threaded = false;
-                op->no_readonly = false;
-                op->time_spent = 0;
-                op->commands_enqueued = 0;
+            /* Re-evaluate columns to set write flags if system is active.
+             * If system is inactive, it can't write anything and so it
+             * should not insert unnecessary merges.  */
+            needs_merge = false;
+            if (is_active) {
+                needs_merge = flecs_pipeline_check_terms(
+                    world, &q->filter, true, &ws);
             }
 
-            /* Don't increase count for inactive systems, as they are ignored by
-             * the query used to run the pipeline. */
-            if (is_active) {
-                ecs_vec_append_t(a, &pq->systems, ecs_entity_t)[0] = 
-                    it.entities[i];
-                if (!op->count) {
-                    op->multi_threaded = multi_threaded;
-                    op->no_readonly = no_readonly;
-                }
-                op->count ++;
+            /* The component states were just reset, so if we conclude that
+             * another merge is needed something is wrong. */
+            ecs_assert(needs_merge == false, ECS_INTERNAL_ERROR, NULL);
+        }
+
+        if (!op) {
+            op = ecs_vec_append_t(a, &pq->ops, ecs_pipeline_op_t);
+            op->offset = ecs_vec_count(&pq->systems);
+            op->count = 0;
+            op->scan_offset = i;
+            op->multi_threaded = false;
+            op->no_readonly = false;
+            op->parallel = false;
+            op->time_spent = 0;
+            op->wait_time = 0;
+            op->commands_enqueued = 0;
+            op->deferred_count = 0;
+        }
+
+        /* Don't increase count for inactive systems, as they are ignored by
+         * the query used to run the pipeline. */
+        if (is_active) {
+            ecs_pipeline_system_t *elem = ecs_vec_append_t(
+                a, &pq->systems, ecs_pipeline_system_t);
+            elem->system = scan[i].system;
+            elem->sys = sys;
+            elem->phase = sys_phase;
+            ecs_vec_append_t(a, &op_systems, ecs_system_t*)[0] = sys;
+            if (!op->count) {
+                op->multi_threaded = multi_threaded;
+                op->no_readonly = no_readonly;
             }
+            op->count ++;
         }
     }
 
@@ -58617,41 +60260,54 @@ bool flecs_pipeline_build(
 
     ecs_map_fini(&ws.ids);
     ecs_map_fini(&ws.wildcard_ids);
+    ecs_vec_fini_t(a, &op_systems, ecs_system_t*);
+}
 
-    op = ecs_vec_first_t(&pq->ops, ecs_pipeline_op_t);
+/* Add schedule to debug tracing and find the op to continue from if the
+ * schedule changed while the pipeline was running. */
+static
+void flecs_pipeline_build_finish(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq)
+{
+    ecs_pipeline_op_t *op = ecs_vec_first_t(&pq->ops, ecs_pipeline_op_t);
 
     if (!op) {
         ecs_dbg("#[green]pipeline#[reset] is empty");
-        return true;
+        return;
     } else {
         /* Add schedule to debug tracing */
         ecs_dbg("#[bold]pipeline rebuild");
         ecs_log_push_1();
 
-        ecs_dbg("#[green]schedule#[reset]: threading: %d, staging: %d:", 
+        ecs_dbg("#[green]schedule#[reset]: threading: %d, staging: %d:",
             op->multi_threaded, !op->no_readonly);
         ecs_log_push_1();
 
         int32_t i, count = ecs_vec_count(&pq->systems);
         int32_t op_index = 0, ran_since_merge = 0;
-        ecs_entity_t *systems = ecs_vec_first_t(&pq->systems, ecs_entity_t);
+        ecs_pipeline_system_t *systems = ecs_vec_first_t(
+            &pq->systems, ecs_pipeline_system_t);
         for (i = 0; i < count; i ++) {
-            ecs_entity_t system = systems[i];
-            const EcsPoly *poly = ecs_get_pair(world, system, EcsPoly, EcsSystem);
-            ecs_poly_assert(poly->poly, ecs_system_t);
-            ecs_system_t *sys = (ecs_system_t*)poly->poly;
+            ecs_entity_t system = systems[i].system;
+            ecs_system_t *sys = systems[i].sys;
 
 #ifdef FLECS_LOG_1
             char *path = ecs_get_fullpath(world, system);
             const char *doc_name = NULL;
 #ifdef FLECS_DOC
-            const EcsDocDescription *doc_name_id = ecs_get_pair(world, system, 
+            const EcsDocDescription *doc_name_id = ecs_get_pair(world, system,
                 EcsDocDescription, EcsName);
             if (doc_name_id) {
                 doc_name = doc_name_id->value;
             }
 #endif
-            if (doc_name) {
+            if (op[op_index].parallel) {
+                ecs_pipeline_node_t *node = ecs_vec_get_t(
+                    &pq->nodes, ecs_pipeline_node_t, i);
+                ecs_dbg("#[green]system#[reset] %s (stage: %d, depends: %d)",
+                    path, node->stage, node->dep_count);
+            } else if (doc_name) {
                 ecs_dbg("#[green]system#[reset] %s (%s)", path, doc_name);
             } else {
                 ecs_dbg("#[green]system#[reset] %s", path);
@@ -58672,7 +60328,7 @@ bool flecs_pipeline_build(
                     ecs_dbg(
                         "#[green]schedule#[reset]: "
                         "threading: %d, staging: %d:",
-                        op[op_index].multi_threaded, 
+                        op[op_index].multi_threaded,
                         !op[op_index].no_readonly);
                 }
                 ecs_log_push_1();
@@ -58693,11 +60349,169 @@ bool flecs_pipeline_build(
         ecs_log_pop_1();
     }
 
-    pq->match_count = pq->query->match_count;
-
     ecs_assert(pq->cur_op <= ecs_vec_last_t(&pq->ops, ecs_pipeline_op_t),
         ECS_INTERNAL_ERROR, NULL);
+}
+
+static
+bool flecs_pipeline_build(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq)
+{
+    ecs_allocator_t *a = &world->allocator;
+    int32_t stage_count = ecs_get_stage_count(world);
+
+    /* The dependency graph assigns systems to stages, so a graph built for
+     * a different number of stages can't be reused */
+    bool rebuild_graph = pq->parallel_systems &&
+        pq->node_stage_count != stage_count;
+
+    /* Same as ecs_query_iter, make sure that the matched tables and the match
+     * count are up to date */
+    ecs_query_t *query = pq->query;
+    flecs_process_pending_tables(world);
+    flecs_query_sort_tables(world, query);
+    if (query->flags & EcsQueryHasRefs) {
+        flecs_eval_component_monitors(world);
+    }
+
+    /* Systems can move in and out of tables that remain matched, which doesn't
+     * change the match count but does change the matched list */
+    uint64_t match_key = flecs_pipeline_match_key(world, pq, &pq->match_next);
+    bool same_match = match_key == pq->match_key && 
+        flecs_pipeline_matched_equal(&pq->matched, &pq->match_next);
+    bool rematch = pq->match_count != query->match_count || !same_match;
+    bool reorder = pq->order_by_priority && 
+        pq->priority_version != world->system_priority_version;
+    bool reinit = pq->system_version != world->system_version;
+
+    if (!rematch && !reorder && !reinit) {
+        if (!rebuild_graph) {
+            /* No need to rebuild the pipeline */
+            return false;
+        }
+
+        flecs_pipeline_build_graph(world, pq, 0);
+        flecs_pipeline_build_finish(world, pq);
+        return true;
+    }
+
+    if (reinit) {
+        /* Schedules store flags of systems, which may have changed */
+        flecs_pipeline_schedules_clear(a, pq);
+        pq->system_version = world->system_version;
+    } else if (match_key) {
+        /* The matched list identifies the matched systems, so if it's the
+         * same as the list of the current or a cached schedule the query 
+         * doesn't have to be iterated and systems don't have to be sorted. */
+        bool current = same_match && !reorder;
+        int32_t cached = -1;
+        if (!current) {
+            cached = flecs_pipeline_schedule_find_key(pq, match_key, 
+                &pq->match_next, world->system_priority_version);
+        }
+
+        if (current || cached != -1) {
+            pq->match_count = query->match_count;
+
+            if (cached != -1) {
+                ecs_vec_clear(&pq->wait_times);
+                flecs_pipeline_schedule_swap(pq, ecs_vec_get_t(
+                    &pq->schedules, ecs_pipeline_schedule_t, cached));
+                rebuild_graph = pq->parallel_systems && 
+                    pq->node_stage_count != stage_count;
+            } else if (!rebuild_graph) {
+                return false;
+            }
+
+            if (rebuild_graph) {
+                flecs_pipeline_build_graph(world, pq, 0);
+            }
+            flecs_pipeline_build_finish(world, pq);
+            return true;
+        }
+    }
+
+    ecs_vec_t scan;
+    if (rematch) {
+        ecs_vec_init_t(a, &scan, ecs_pipeline_scan_t, 0);
+        flecs_pipeline_scan(world, pq, &scan);
+    } else {
+        /* Only priorities changed, reorder systems without iterating query */
+        scan = ecs_vec_copy_t(a, &pq->scan, ecs_pipeline_scan_t);
+    }
+
+    /* Iterating the query can reset the match count */
+    pq->match_count = query->match_count;
+
+    if (pq->order_by_priority) {
+        flecs_pipeline_scan_sort(world, &scan);
+    }
+
+    uint64_t hash = flecs_pipeline_scan_hash(&scan);
+
+    if (!reinit && pq->rebuild_count && hash == pq->scan_hash &&
+        flecs_pipeline_scan_equal(&pq->scan, &scan))
+    {
+        /* Query was rematched or priorities changed but the order of systems 
+         * didn't change */
+        ecs_vec_fini_t(a, &scan, ecs_pipeline_scan_t);
+        flecs_pipeline_match_set(pq, match_key);
+        pq->priority_version = world->system_priority_version;
+        if (!rebuild_graph) {
+            return false;
+        }
+
+        flecs_pipeline_build_graph(world, pq, 0);
+        flecs_pipeline_build_finish(world, pq);
+        return true;
+    }
+
+    ecs_vec_clear(&pq->wait_times);
+
+    int32_t cached = flecs_pipeline_schedule_find(pq, hash, &scan);
+    if (cached != -1) {
+        /* Schedule was built before, swap it with the current schedule so that
+         * the current schedule can be swapped back in later. */
+        ecs_vec_fini_t(a, &scan, ecs_pipeline_scan_t);
+        flecs_pipeline_schedule_swap(pq, ecs_vec_get_t(
+            &pq->schedules, ecs_pipeline_schedule_t, cached));
+        flecs_pipeline_match_set(pq, match_key);
+        pq->priority_version = world->system_priority_version;
+        if (pq->parallel_systems && pq->node_stage_count != stage_count) {
+            flecs_pipeline_build_graph(world, pq, 0);
+        }
+        flecs_pipeline_build_finish(world, pq);
+        return true;
+    }
+
+    world->info.pipeline_build_count_total ++;
+
+    /* Only rebuild ops that come after the first system that changed */
+    int32_t op_index = 0;
+    if (pq->rebuild_count && !reinit) {
+        flecs_pipeline_schedule_store(world, pq);
+        op_index = flecs_pipeline_resume_op(pq, &scan);
+    }
+
+    pq->rebuild_count ++;
 
+    ecs_vec_fini_t(a, &pq->scan, ecs_pipeline_scan_t);
+    pq->scan = scan;
+    pq->scan_hash = hash;
+    flecs_pipeline_match_set(pq, match_key);
+    pq->priority_version = world->system_priority_version;
+
+    flecs_pipeline_build_ops(world, pq, op_index);
+
+    if (pq->parallel_systems) {
+        if (rebuild_graph) {
+            op_index = 0;
+        }
+        flecs_pipeline_build_graph(world, pq, op_index);
+    }
+
+    flecs_pipeline_build_finish(world, pq);
     return true;
 }
 
@@ -58736,7 +60550,26 @@ bool flecs_pipeline_update(
     ecs_assert(pq != NULL, ECS_INTERNAL_ERROR, NULL);
     ecs_assert(pq->query != NULL, ECS_INTERNAL_ERROR, NULL);
 
+    ecs_time_t t = {0};
+    bool measure_time = world->flags & EcsWorldMeasureFrameTime;
+    if (measure_time) {
+        ecs_time_measure(&t);
+    }
+
+    uint64_t trace_start = flecs_trace_now(world);
+
     bool rebuilt = flecs_pipeline_build(world, pq);
+
+    if (measure_time) {
+        world->info.pipeline_build_time_total += 
+            (ecs_ftime_t)ecs_time_measure(&t);
+    }
+
+    if (rebuilt && trace_start) {
+        flecs_trace_event(world, &world->stages[0], EcsTraceRebuild, 0, 
+            trace_start);
+    }
+
     if (start_of_frame) {
         /* Initialize iterators */
         int32_t i, count = pq->iter_count;
@@ -58777,6 +60610,223 @@ void ecs_run_pipeline(
     }
 }
 
+/* Returns whether current op should run its systems as a dependency graph. If
+ * the op was resumed halfway after a rebuild, the remaining systems are ran
+ * the regular way. */
+static
+bool flecs_pipeline_run_parallel(
+    ecs_pipeline_state_t *pq,
+    int32_t stage_count)
+{
+    ecs_pipeline_op_t *op = pq->cur_op;
+    return op->parallel && stage_count > 1 && pq->cur_i == op->offset &&
+        pq->node_stage_count == stage_count;
+}
+
+/* Decide whether systems of a phase run in the current frame. A phase that is
+ * deferred by the frame budget too many frames in a row runs regardless of the
+ * budget, so that it isn't starved by frames that are always busy. */
+static
+void flecs_pipeline_phase_decide(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    ecs_pipeline_phase_t *phase)
+{
+    phase->skip = false;
+    phase->deferred = false;
+
+    if (!ecs_is_alive(world, phase->phase)) {
+        return;
+    }
+
+    const EcsPhaseSchedule *ps = ecs_get(world, phase->phase, EcsPhaseSchedule);
+    if (!ps) {
+        return;
+    }
+
+    int64_t frame = world->info.frame_count_total;
+    if (ps->interval > 1 && (frame - phase->last_run) < ps->interval) {
+        phase->skip = true;
+        return;
+    }
+
+    if (pq->frame_budget > 0 && ps->priority_class > 0 &&
+        phase->deferrals < FLECS_PIPELINE_MAX_DEFERRALS)
+    {
+        ecs_time_t t = pq->frame_start;
+        double elapsed = ecs_time_measure(&t);
+        double threshold = (double)pq->frame_budget * (1.0 - 
+            FLECS_PIPELINE_CLASS_STEP * (double)(ps->priority_class - 1));
+        if (elapsed >= threshold) {
+            /* Don't update last_run, so phase runs as soon as possible */
+            phase->skip = true;
+            phase->deferred = true;
+            phase->deferrals ++;
+            pq->cur_op->deferred_count ++;
+            return;
+        }
+    }
+
+    phase->deferrals = 0;
+    phase->last_run = frame;
+}
+
+/* Decide phase of system if it wasn't decided yet in the current frame. A 
+ * phase is decided once per frame when its first system is reached, so that
+ * all systems of a phase either run or are skipped. */
+static
+void flecs_pipeline_phase_reached(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    const ecs_pipeline_system_t *system)
+{
+    if (system->phase == -1) {
+        return;
+    }
+
+    ecs_pipeline_phase_t *phase = ecs_vec_get_t(
+        &pq->phases, ecs_pipeline_phase_t, system->phase);
+    int64_t frame = world->info.frame_count_total;
+    if (phase->decided_frame != frame) {
+        phase->decided_frame = frame;
+        flecs_pipeline_phase_decide(world, pq, phase);
+    }
+}
+
+/* Decide which phases of the systems in the current op are skipped. Used for 
+ * ops that run on multiple threads, and must be called before workers are 
+ * signaled, as workers read the result. Ops that run on the main thread decide
+ * a phase when its first system is reached instead. */
+static
+void flecs_pipeline_schedule_phases(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq)
+{
+    ecs_pipeline_op_t *op = pq->cur_op;
+    ecs_pipeline_system_t *systems = ecs_vec_first_t(
+        &pq->systems, ecs_pipeline_system_t);
+    int32_t i, last = op->offset + op->count;
+
+    for (i = pq->cur_i; i < last; i ++) {
+        flecs_pipeline_phase_reached(world, pq, &systems[i]);
+    }
+}
+
+static
+bool flecs_pipeline_system_skipped(
+    const ecs_pipeline_state_t *pq,
+    const ecs_pipeline_system_t *system)
+{
+    if (!pq->phase_scheduling || system->phase == -1) {
+        return false;
+    }
+    return ecs_vec_get_t(&pq->phases, ecs_pipeline_phase_t, 
+        system->phase)->skip;
+}
+
+/* Reset dependency counters before threads start running a parallel op. When
+ * system time is measured, systems are reassigned to stages using the time
+ * they took in the previous frame. */
+static
+void flecs_pipeline_reset_nodes(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq)
+{
+    ecs_pipeline_op_t *op = pq->cur_op;
+    if (world->flags & EcsWorldMeasureSystemTime) {
+        flecs_pipeline_assign_stages(world, pq, op, true);
+    }
+
+    ecs_pipeline_node_t *nodes = ecs_vec_first_t(
+        &pq->nodes, ecs_pipeline_node_t);
+    int32_t i, last = op->offset + op->count;
+    for (i = op->offset; i < last; i ++) {
+        nodes[i].wait_count = nodes[i].dep_count;
+    }
+}
+
+/* Wait until all systems the node depends on have ran. The acquire load makes
+ * writes of dependencies visible. When a dependency takes longer than a short 
+ * spin the thread sleeps in between checks, so that waiting threads don't 
+ * starve the thread that runs the dependency when there are more threads than
+ * cores. */
+static
+void flecs_pipeline_node_wait(
+    ecs_world_t *world,
+    ecs_stage_t *stage,
+    ecs_pipeline_node_t *node)
+{
+    if (!node->dep_count || !flecs_atomic_load(&node->wait_count)) {
+        return;
+    }
+
+    ecs_time_t t = {0};
+    bool measure_time = world->flags & EcsWorldMeasureSystemTime;
+    if (measure_time) {
+        ecs_time_measure(&t);
+    }
+
+    int32_t spin = 0;
+    while (flecs_atomic_load(&node->wait_count)) {
+        if (spin < FLECS_PIPELINE_NODE_SPIN) {
+            flecs_spin_pause();
+            spin ++;
+        } else {
+            ecs_os_sleep(0, 0);
+        }
+    }
+
+    if (measure_time) {
+        stage->node_wait_time += ecs_time_measure(&t);
+    }
+}
+
+/* Run the systems of a parallel op that were assigned to the stage. Each
+ * system runs on a single stage, after the systems it conflicts with. */
+static
+int32_t flecs_run_pipeline_graph(
+    ecs_world_t *world,
+    ecs_stage_t *stage,
+    int32_t stage_index,
+    ecs_ftime_t delta_time)
+{
+    ecs_pipeline_state_t *pq = world->pq;
+    ecs_pipeline_op_t *op = pq->cur_op;
+    ecs_pipeline_system_t *systems = ecs_vec_first_t(
+        &pq->systems, ecs_pipeline_system_t);
+    ecs_pipeline_node_t *nodes = ecs_vec_first_t(
+        &pq->nodes, ecs_pipeline_node_t);
+    int32_t *edges = ecs_vec_first_t(&pq->edges, int32_t);
+    int32_t i, last = op->offset + op->count;
+
+    for (i = op->offset; i < last; i ++) {
+        ecs_pipeline_node_t *node = &nodes[i];
+        if (node->stage != stage_index) {
+            continue;
+        }
+
+        flecs_pipeline_node_wait(world, stage, node);
+
+        /* Run system as a whole on this stage */
+        if (!flecs_pipeline_system_skipped(pq, &systems[i])) {
+            uint64_t trace_start = flecs_trace_now(world);
+            ecs_run_intern(world, stage, systems[i].system, systems[i].sys,
+                stage_index, 1, delta_time, 0, 0, NULL);
+            if (trace_start) {
+                flecs_trace_event(world, stage, EcsTraceSystem, 
+                    systems[i].system, trace_start);
+            }
+        }
+
+        int32_t e;
+        for (e = 0; e < node->edge_count; e ++) {
+            ecs_os_adec(&nodes[edges[node->edge_offset + e]].wait_count);
+        }
+    }
+
+    return last - 1;
+}
+
 int32_t flecs_run_pipeline_ops(
     ecs_world_t* world,
     ecs_stage_t* stage,
@@ -58790,32 +60840,37 @@ int32_t flecs_run_pipeline_ops(
 
     ecs_assert(!stage_index || op->multi_threaded, ECS_INTERNAL_ERROR, NULL);
 
+    if (flecs_pipeline_run_parallel(pq, stage_count)) {
+        return flecs_run_pipeline_graph(world, stage, stage_index, delta_time);
+    }
+
     int32_t count = ecs_vec_count(&pq->systems);
-    ecs_entity_t* systems = ecs_vec_first_t(&pq->systems, ecs_entity_t);
+    ecs_pipeline_system_t* systems = ecs_vec_first_t(
+        &pq->systems, ecs_pipeline_system_t);
     int32_t ran_since_merge = i - op->offset;
 
-    for (; i < count; i++) {
-        ecs_entity_t system = systems[i];
-        const EcsPoly* poly = ecs_get_pair(world, system, EcsPoly, EcsSystem);
-        ecs_poly_assert(poly->poly, ecs_system_t);
-        ecs_system_t* sys = (ecs_system_t*)poly->poly;
-
-        /* Keep track of the last frame for which the system has ran, so we
-        * know from where to resume the schedule in case the schedule
-        * changes during a merge. */
-        sys->last_frame = world->info.frame_count_total + 1;
+    ecs_stage_t* s = NULL;
+    if (!op->no_readonly) {
+        /* If system is no_readonly it operates on the actual world, not
+         * the stage. Only pass stage to system if it's readonly. */
+        s = stage;
+    }
 
-        ecs_stage_t* s = NULL;
-        if (!op->no_readonly) {
-            /* If system is no_readonly it operates on the actual world, not
-             * the stage. Only pass stage to system if it's readonly. */
-            s = stage;
+    for (; i < count; i++) {
+        if (pq->phase_lazy) {
+            flecs_pipeline_phase_reached(world, pq, &systems[i]);
         }
 
-        ecs_run_intern(world, s, system, sys, stage_index,
-            stage_count, delta_time, 0, 0, NULL);
+        if (!flecs_pipeline_system_skipped(pq, &systems[i])) {
+            uint64_t trace_start = flecs_trace_now(world);
+            ecs_run_intern(world, s, systems[i].system, systems[i].sys, 
+                stage_index, stage_count, delta_time, 0, 0, NULL);
+            if (trace_start) {
+                flecs_trace_event(world, stage, EcsTraceSystem, 
+                    systems[i].system, trace_start);
+            }
+        }
 
-        world->info.systems_ran_frame++;
         ran_since_merge++;
 
         if (ran_since_merge == op->count) {
@@ -58827,6 +60882,32 @@ int32_t flecs_run_pipeline_ops(
     return i;
 }
 
+/* Keep track of the last frame for which systems have ran, so we know from
+ * where to resume the schedule in case the schedule changes during a merge. 
+ * This is done by the main thread after the workers synchronized, so that 
+ * workers don't write to data that's shared between threads. Systems of 
+ * skipped phases are passed, but aren't counted as ran. */
+static
+void flecs_pipeline_systems_ran(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    int32_t last)
+{
+    ecs_pipeline_system_t *systems = ecs_vec_first_t(
+        &pq->systems, ecs_pipeline_system_t);
+    int64_t frame = world->info.frame_count_total + 1;
+    int32_t i, first = pq->cur_i;
+    last = ECS_MIN(last, ecs_vec_count(&pq->systems) - 1);
+
+    int32_t ran = 0;
+    for (i = first; i <= last; i ++) {
+        systems[i].sys->last_frame = frame;
+        ran += !flecs_pipeline_system_skipped(pq, &systems[i]);
+    }
+
+    world->info.systems_ran_frame += ran;
+}
+
 void flecs_run_pipeline(
     ecs_world_t *world,
     ecs_pipeline_state_t *pq,
@@ -58845,12 +60926,23 @@ void flecs_run_pipeline(
 
     bool multi_threaded = ecs_get_stage_count(world) > 1;
 
+    uint64_t trace_start = flecs_trace_now(world);
+
+    if (pq->frame_budget > 0) {
+        ecs_os_get_time(&pq->frame_start);
+    }
+
     // Update the pipeline the workers will execute
     world->pq = pq;
 
     // Update the pipeline before waking the workers.
     flecs_pipeline_update(world, pq, true);
 
+    // Only check phase schedules if the pipeline can skip phases
+    ecs_id_record_t *idr = flecs_id_record_get(world, ecs_id(EcsPhaseSchedule));
+    pq->phase_scheduling = pq->frame_budget > 0 || 
+        (idr && flecs_table_cache_count(&idr->cache));
+
     // If there are no operations to execute in the pipeline bail early,
     // no need to wake the workers since they have nothing to do.
     while (pq->cur_op != NULL) {
@@ -58871,7 +60963,18 @@ void flecs_run_pipeline(
         ECS_BIT_COND(world->flags, EcsWorldMultiThreaded, op_multi_threaded);
         ecs_assert(world->workers_waiting == 0, ECS_INTERNAL_ERROR, NULL);
 
+        /* Workers read which phases are skipped, so decide phases of a multi
+         * threaded op before they're signaled. Ops on the main thread decide
+         * a phase when its first system is reached. */
+        pq->phase_lazy = pq->phase_scheduling && !op_multi_threaded;
+        if (pq->phase_scheduling && op_multi_threaded) {
+            flecs_pipeline_schedule_phases(world, pq);
+        }
+
         if (op_multi_threaded) {
+            if (flecs_pipeline_run_parallel(pq, stage_count)) {
+                flecs_pipeline_reset_nodes(world, pq);
+            }
             flecs_signal_workers(world);
         }
 
@@ -58889,10 +60992,32 @@ void flecs_run_pipeline(
             world->info.system_time_total += (ecs_ftime_t)ecs_time_measure(&st);
         }
 
+        if (pq->coalesce_commands && !no_readonly) {
+            flecs_commands_coalesce(stage);
+        }
+
         if (op_multi_threaded) {
+            ecs_time_t wt = { 0 };
+            if (measure_time) {
+                ecs_time_measure(&wt);
+            }
+
+            uint64_t trace_wait = flecs_trace_now(world);
+
             flecs_wait_for_sync(world);
+
+            if (measure_time) {
+                flecs_record_sync_wait(world, pq, 
+                    (ecs_ftime_t)ecs_time_measure(&wt));
+            }
+
+            if (trace_wait) {
+                flecs_trace_event(world, stage, EcsTraceWait, 0, trace_wait);
+            }
         }
 
+        flecs_pipeline_systems_ran(world, pq, i);
+
         if (!no_readonly) {
             ecs_time_t mt = { 0 };
             if (measure_time) {
@@ -58905,6 +61030,16 @@ void flecs_run_pipeline(
                 pq->cur_op->commands_enqueued += ecs_vec_count(&s->cmd->queue);
             }
 
+            /* Workers finished enqueueing commands, apply the commands that 
+             * can be applied in parallel before merging the rest */
+            if (op_multi_threaded && pq->parallel_merge) {
+                pq->applying = true;
+                flecs_signal_workers(world);
+                flecs_commands_apply(world, stage);
+                flecs_wait_for_sync(world);
+                pq->applying = false;
+            }
+
             ecs_readonly_end(world);
             if (measure_time) {
                 pq->cur_op->time_spent += ecs_time_measure(&mt);
@@ -58917,6 +61052,10 @@ void flecs_run_pipeline(
 
         flecs_pipeline_update(world, pq, false);
     }
+
+    if (trace_start) {
+        flecs_trace_event(world, stage, EcsTraceFrame, 0, trace_start);
+    }
 }
 
 static
@@ -58948,8 +61087,7 @@ void flecs_run_startup_systems(
                 { .id = ecs_dependson(EcsOnStart), .src.trav = EcsDependsOn },
                 { .id = EcsDisabled, .src.flags = EcsUp, .src.trav = EcsDependsOn, .oper = EcsNot },
                 { .id = EcsDisabled, .src.flags = EcsUp, .src.trav = EcsChildOf, .oper = EcsNot }
-            },
-            .order_by = flecs_entity_compare
+            }
         }
     });
     ecs_log_pop_2();
@@ -59059,10 +61197,9 @@ ecs_entity_t ecs_pipeline_init(
         result = ecs_new(world, 0);
     }
 
+    /* Without a custom order_by the pipeline orders systems itself, which is
+     * cheaper than sorting the query and supports system priorities */
     ecs_query_desc_t qd = desc->query;
-    if (!qd.order_by) {
-        qd.order_by = flecs_entity_compare;
-    }
     qd.filter.entity = result;
 
     ecs_query_t *query = ecs_query_init(world, &qd);
@@ -59079,6 +61216,12 @@ ecs_entity_t ecs_pipeline_init(
     ecs_pipeline_state_t *pq = ecs_os_calloc_t(ecs_pipeline_state_t);
     pq->query = query;
     pq->match_count = -1;
+    pq->parallel_systems = desc->parallel_systems;
+    pq->order_by_priority = desc->query.order_by == NULL;
+    pq->coalesce_commands = desc->coalesce_commands;
+    pq->parallel_merge = desc->parallel_merge;
+    pq->frame_budget = desc->frame_budget;
+    ecs_map_init(&pq->phase_index, &world->allocator);
     pq->idr_inactive = flecs_id_record_ensure(world, EcsEmpty);
     ecs_set(world, result, EcsPipeline, { pq });
 
@@ -59117,6 +61260,13 @@ void flecs_bootstrap_phase_(
     }
 }
 
+/* Pipelines start a new op for phases that can be deferred by the frame 
+ * budget, so rebuild pipelines when a phase schedule changes */
+static
+void flecs_on_phase_schedule(ecs_iter_t *it) {
+    it->real_world->system_version ++;
+}
+
 void FlecsPipelineImport(
     ecs_world_t *world)
 {
@@ -59126,6 +61276,7 @@ void FlecsPipelineImport(
     ecs_set_name_prefix(world, "Ecs");
 
     flecs_bootstrap_component(world, EcsPipeline);
+    flecs_bootstrap_component(world, EcsPhaseSchedule);
     flecs_bootstrap_tag(world, EcsPhase);
 
     /* Create anonymous phases to which the builtin phases will have DependsOn 
@@ -59160,6 +61311,12 @@ void FlecsPipelineImport(
         .move = ecs_move(EcsPipeline)
     });
 
+    ecs_set_hooks(world, EcsPhaseSchedule, {
+        .ctor = ecs_default_ctor,
+        .on_set = flecs_on_phase_schedule,
+        .on_remove = flecs_on_phase_schedule
+    });
+
     world->pipeline = ecs_pipeline(world, {
         .entity = ecs_entity(world, { .name = "BuiltinPipeline" }),
         .query = {
@@ -59169,8 +61326,7 @@ void FlecsPipelineImport(
                 { .id = ecs_dependson(EcsOnStart), .src.trav = EcsDependsOn, .oper = EcsNot },
                 { .id = EcsDisabled, .src.flags = EcsUp, .src.trav = EcsDependsOn, .oper = EcsNot },
                 { .id = EcsDisabled, .src.flags = EcsUp, .src.trav = EcsChildOf, .oper = EcsNot }
-            },
-            .order_by = flecs_entity_compare
+            }
         }
     });
 
@@ -59188,26 +61344,101 @@ void FlecsPipelineImport(
 
 #ifdef FLECS_PIPELINE
 
+/* Spin until value becomes equal (or not equal) to cmp. Returns false if the
+ * spin budget ran out, in which case the caller should block. The budget adapts
+ * to how long sync points take: it grows when spinning pays off and shrinks
+ * when the thread had to block anyway. */
+static
+bool flecs_sync_spin(
+    ecs_world_t *world,
+    ecs_stage_t *stage,
+    int32_t *value,
+    int32_t cmp,
+    bool until_equal)
+{
+    int32_t max = world->sync_spin_max;
+    if (max <= 0) {
+        return false;
+    }
+
+    int32_t budget = stage->sync_spin;
+    if (budget <= 0 || budget > max) {
+        budget = max;
+    }
+
+    int32_t i;
+    for (i = 0; i < budget; i ++) {
+        /* Acquire load makes what was written before the value changed 
+         * visible */
+        if ((flecs_atomic_load(value) == cmp) == until_equal) {
+            stage->sync_spin = ECS_MIN(budget * 2, max);
+            return true;
+        }
+        flecs_spin_pause();
+    }
+
+    stage->sync_spin = ECS_MAX(budget / 2, ECS_MAX(max / 8, 1));
+    return false;
+}
+
+/* Wait until main thread signals that worker can continue */
+static
+void flecs_wait_for_signal(
+    ecs_world_t *world,
+    ecs_stage_t *stage,
+    int32_t generation)
+{
+    if (flecs_sync_spin(world, stage, &world->sync_generation, generation,
+        false)) 
+    {
+        return;
+    }
+
+    ecs_os_mutex_lock(world->sync_mutex);
+    ecs_os_ainc(&world->workers_parked);
+    while (*(volatile int32_t*)&world->sync_generation == generation) {
+        ecs_os_cond_wait(world->worker_cond, world->sync_mutex);
+    }
+    ecs_os_adec(&world->workers_parked);
+    ecs_os_mutex_unlock(world->sync_mutex);
+}
+
 /* Synchronize workers */
 static
 void flecs_sync_worker(
-    ecs_world_t* world)
+    ecs_world_t* world,
+    ecs_stage_t *stage)
 {
     int32_t stage_count = ecs_get_stage_count(world);
     if (stage_count <= 1) {
         return;
     }
 
-    /* Signal that thread is waiting */
-    ecs_os_mutex_lock(world->sync_mutex);
-    if (++world->workers_waiting == (stage_count - 1)) {
-        /* Only signal main thread when all threads are waiting */
-        ecs_os_cond_signal(world->sync_cond);
+    /* Read generation before signaling that thread is waiting, as the main 
+     * thread can continue as soon as the last worker arrives. */
+    int32_t generation = *(volatile int32_t*)&world->sync_generation;
+
+    if (world->flags & EcsWorldMeasureSystemTime) {
+        ecs_os_get_time(&stage->sync_time);
     }
 
-    /* Wait until main thread signals that thread can continue */
-    ecs_os_cond_wait(world->worker_cond, world->sync_mutex);
-    ecs_os_mutex_unlock(world->sync_mutex);
+    uint64_t trace_start = flecs_trace_now(world);
+
+    /* Signal that thread is waiting. Only wake up main thread when all threads
+     * are waiting, and main thread isn't spinning. */
+    if (ecs_os_ainc(&world->workers_waiting) == (stage_count - 1)) {
+        if (*(volatile int32_t*)&world->main_parked) {
+            ecs_os_mutex_lock(world->sync_mutex);
+            ecs_os_cond_signal(world->sync_cond);
+            ecs_os_mutex_unlock(world->sync_mutex);
+        }
+    }
+
+    flecs_wait_for_signal(world, stage, generation);
+
+    if (trace_start) {
+        flecs_trace_event(world, stage, EcsTraceWait, 0, trace_start);
+    }
 }
 
 /* Worker thread */
@@ -59221,27 +61452,57 @@ void* flecs_worker(void *arg) {
 
     ecs_dbg_2("worker %d: start", stage->id);
 
+    if (stage->cpu != -1) {
+        if (ecs_os_thread_set_affinity(stage->cpu)) {
+            ecs_warn("worker %d: failed to pin thread to cpu %d", 
+                stage->id, stage->cpu);
+        } else {
+            ecs_dbg_2("worker %d: pinned to cpu %d", stage->id, stage->cpu);
+        }
+    }
+
+    /* Reserve command storage from the worker thread, after it is pinned, so
+     * that memory is first touched by the cpu that uses it */
+    if (world->worker_arena_size) {
+        flecs_commands_reserve(stage, world->worker_arena_size);
+    }
+
     /* Start worker, increase counter so main thread knows how many
      * workers are ready */
     ecs_os_mutex_lock(world->sync_mutex);
+    int32_t generation = world->sync_generation;
     world->workers_running ++;
+    ecs_os_mutex_unlock(world->sync_mutex);
 
     if (!(world->flags & EcsWorldQuitWorkers)) {
-        ecs_os_cond_wait(world->worker_cond, world->sync_mutex);
+        flecs_wait_for_signal(world, stage, generation);
     }
 
-    ecs_os_mutex_unlock(world->sync_mutex);
-
     while (!(world->flags & EcsWorldQuitWorkers)) {
+        ecs_pipeline_state_t *pq = world->pq;
+        if (pq->applying) {
+            /* Main thread signaled workers after the systems of the op ran */
+            ecs_dbg_3("worker %d: apply", stage->id);
+            flecs_commands_apply(world, stage);
+            flecs_sync_worker(world, stage);
+            continue;
+        }
+
         ecs_entity_t old_scope = ecs_set_scope((ecs_world_t*)stage, 0);
 
         ecs_dbg_3("worker %d: run", stage->id);
         flecs_run_pipeline_ops(world, stage, stage->id, world->stage_count, 
             world->info.delta_time);
 
+        /* Coalesce commands before synchronizing, so that stages coalesce
+         * their commands in parallel instead of during the merge. */
+        if (pq->coalesce_commands && !pq->no_readonly) {
+            flecs_commands_coalesce(stage);
+        }
+
         ecs_set_scope((ecs_world_t*)stage, old_scope);
 
-        flecs_sync_worker(world);
+        flecs_sync_worker(world, stage);
     }
 
     ecs_dbg_2("worker %d: finalizing", stage->id);
@@ -59255,6 +61516,131 @@ void* flecs_worker(void *arg) {
     return NULL;
 }
 
+/* Get the order in which workers are assigned to cpus. Returns the number of
+ * cpus in the order, or 0 if the cpus are not known. */
+static
+int32_t flecs_worker_cpu_order(
+    ecs_thread_affinity_t affinity,
+    int32_t **order_out)
+{
+    if (!ecs_os_api.cpu_topology_) {
+        return 0;
+    }
+
+    int32_t i, j, count = ecs_os_cpu_topology(NULL, 0);
+    if (count <= 0) {
+        return 0;
+    }
+
+    ecs_os_cpu_t *cpus = ecs_os_malloc_n(ecs_os_cpu_t, count);
+    int32_t online = ecs_os_cpu_topology(cpus, count);
+    if (online < count) {
+        count = online; /* Cpu went offline between calls */
+    }
+
+    int32_t *order = ecs_os_malloc_n(int32_t, count);
+    if (affinity != EcsAffinityTopology) {
+        for (i = 0; i < count; i ++) {
+            order[i] = cpus[i].id;
+        }
+        goto done;
+    }
+
+    /* Rank cpus by hardware thread within their core, so that each physical 
+     * core gets a worker before any core gets a second one. */
+    int32_t *rank = ecs_os_malloc_n(int32_t, count);
+    int32_t max_rank = 0;
+    for (i = 0; i < count; i ++) {
+        rank[i] = 0;
+        for (j = 0; j < i; j ++) {
+            if (cpus[j].package == cpus[i].package && 
+                cpus[j].core == cpus[i].core) 
+            {
+                rank[i] ++;
+            }
+        }
+        if (rank[i] > max_rank) {
+            max_rank = rank[i];
+        }
+    }
+
+    /* Within a rank, fill packages in order, so that workers share caches and
+     * memory with each other before spilling to the next package */
+    int32_t r, n = 0;
+    for (r = 0; r <= max_rank; r ++) {
+        int32_t package = INT32_MIN;
+        do {
+            int32_t next = INT32_MAX;
+            for (i = 0; i < count; i ++) {
+                if (rank[i] == r && cpus[i].package > package && 
+                    cpus[i].package < next) 
+                {
+                    next = cpus[i].package;
+                }
+            }
+            if (next == INT32_MAX) {
+                break;
+            }
+            for (i = 0; i < count; i ++) {
+                if (rank[i] == r && cpus[i].package == next) {
+                    order[n ++] = cpus[i].id;
+                }
+            }
+            package = next;
+        } while (true);
+    }
+
+    ecs_assert(n == count, ECS_INTERNAL_ERROR, NULL);
+    ecs_os_free(rank);
+done:
+    ecs_os_free(cpus);
+    *order_out = order;
+    return count;
+}
+
+/* Assign cpus to worker stages. The first cpu in the order is left for the 
+ * main thread, which is not pinned. Workers for which no cpu is left, or all
+ * workers if the cpus are not known, are not pinned either. This prevents 
+ * pinning a worker to the cpu of the main thread, or to a cpu that's offline. */
+static
+void flecs_assign_worker_cpus(
+    ecs_world_t *world)
+{
+    int32_t i, stages = ecs_get_stage_count(world);
+    for (i = 0; i < stages; i ++) {
+        world->stages[i].cpu = -1;
+    }
+
+    if (world->worker_affinity == EcsAffinityNone || 
+        ecs_using_task_threads(world)) 
+    {
+        return;
+    }
+
+    if (!ecs_os_has_affinity()) {
+        ecs_warn("cannot pin worker threads: OS API has no thread affinity");
+        return;
+    }
+
+    int32_t *order = NULL;
+    int32_t count = flecs_worker_cpu_order(
+        (ecs_thread_affinity_t)world->worker_affinity, &order);
+    if (!count) {
+        ecs_warn("cannot pin worker threads: cpus are not known");
+        return;
+    }
+
+    for (i = 1; i < stages && i < count; i ++) {
+        world->stages[i].cpu = order[i];
+    }
+
+    if (stages > count) {
+        ecs_dbg_2("%d workers not pinned: not enough cpus", stages - count);
+    }
+
+    ecs_os_free(order);
+}
+
 /* Start threads */
 void flecs_create_worker_threads(
     ecs_world_t *world)
@@ -59262,6 +61648,8 @@ void flecs_create_worker_threads(
     ecs_poly_assert(world, ecs_world_t);
     int32_t stages = ecs_get_stage_count(world);
 
+    flecs_assign_worker_cpus(world);
+
     for (int32_t i = 1; i < stages; i ++) {
         ecs_stage_t *stage = (ecs_stage_t*)ecs_get_stage(world, i);
         ecs_assert(stage != NULL, ECS_INTERNAL_ERROR, NULL);
@@ -59327,17 +61715,24 @@ void flecs_wait_for_sync(
 
     ecs_dbg_3("#[bold]pipeline: waiting for worker sync");
 
-    ecs_os_mutex_lock(world->sync_mutex);
-    if (world->workers_waiting != (stage_count - 1)) {
-        ecs_os_cond_wait(world->sync_cond, world->sync_mutex);
+    int32_t worker_count = stage_count - 1;
+    if (!flecs_sync_spin(world, &world->stages[0], &world->workers_waiting,
+        worker_count, true)) 
+    {
+        ecs_os_mutex_lock(world->sync_mutex);
+        ecs_os_ainc(&world->main_parked);
+        while (*(volatile int32_t*)&world->workers_waiting != worker_count) {
+            ecs_os_cond_wait(world->sync_cond, world->sync_mutex);
+        }
+        ecs_os_adec(&world->main_parked);
+        ecs_os_mutex_unlock(world->sync_mutex);
     }
 
     /* We shouldn't have been signalled unless all workers are waiting on sync */
-    ecs_assert(world->workers_waiting == (stage_count - 1), 
+    ecs_assert(world->workers_waiting == worker_count, 
         ECS_INTERNAL_ERROR, NULL);
 
     world->workers_waiting = 0;
-    ecs_os_mutex_unlock(world->sync_mutex);
 
     ecs_dbg_3("#[bold]pipeline: workers synced");
 }
@@ -59352,9 +61747,62 @@ void flecs_signal_workers(
     }
 
     ecs_dbg_3("#[bold]pipeline: signal workers");
-    ecs_os_mutex_lock(world->sync_mutex);
-    ecs_os_cond_broadcast(world->worker_cond);
-    ecs_os_mutex_unlock(world->sync_mutex);
+
+    /* Flip generation, which releases spinning workers. Only workers that are
+     * blocked need to be woken up. */
+    ecs_os_ainc(&world->sync_generation);
+    if (*(volatile int32_t*)&world->workers_parked) {
+        ecs_os_mutex_lock(world->sync_mutex);
+        ecs_os_cond_broadcast(world->worker_cond);
+        ecs_os_mutex_unlock(world->sync_mutex);
+    }
+}
+
+/* Record how long main thread and workers waited on current sync point */
+void flecs_record_sync_wait(
+    ecs_world_t *world,
+    ecs_pipeline_state_t *pq,
+    ecs_ftime_t main_wait_time)
+{
+    int32_t stage_count = ecs_get_stage_count(world);
+    int32_t op_count = ecs_vec_count(&pq->ops);
+    ecs_allocator_t *a = &world->allocator;
+
+    if (pq->wait_stage_count != stage_count) {
+        ecs_vec_clear(&pq->wait_times);
+        pq->wait_stage_count = stage_count;
+    }
+    ecs_vec_set_min_count_zeromem_t(a, &pq->wait_times, double, 
+        op_count * stage_count);
+
+    ecs_pipeline_op_t *op = pq->cur_op;
+    int32_t op_index = (int32_t)(op - ecs_vec_first_t(&pq->ops, ecs_pipeline_op_t));
+    double *wait_times = ecs_vec_get_t(&pq->wait_times, double, 
+        op_index * stage_count);
+
+    op->wait_time += (double)main_wait_time;
+    wait_times[0] += (double)main_wait_time;
+
+    /* Add time stages waited on systems in parallel ops */
+    int32_t i;
+    for (i = 0; i < stage_count; i ++) {
+        ecs_stage_t *stage = &world->stages[i];
+        if (!i) {
+            op->wait_time += stage->node_wait_time;
+        }
+        wait_times[i] += stage->node_wait_time;
+        stage->node_wait_time = 0;
+    }
+
+    /* The sync point completes when the main thread stops waiting, so workers
+     * waited from when they arrived until now. */
+    ecs_time_t now;
+    ecs_os_get_time(&now);
+
+    for (i = 1; i < stage_count; i ++) {
+        ecs_time_t t = ecs_time_sub(now, world->stages[i].sync_time);
+        wait_times[i] += ecs_time_to_double(t);
+    }
 }
 
 void flecs_join_worker_threads(
@@ -59472,6 +61920,30 @@ void ecs_set_threads(
     flecs_set_threads_internal(world, threads, false /* use thread API */);
 }
 
+void ecs_set_threads_w_desc(
+    ecs_world_t *world,
+    const ecs_threads_desc_t *desc)
+{
+    ecs_poly_assert(world, ecs_world_t);
+    ecs_check(desc != NULL, ECS_INVALID_PARAMETER, NULL);
+    ecs_check(desc->arena_size >= 0, ECS_INVALID_PARAMETER, NULL);
+
+    /* Placement and arenas are applied when threads start, so restart running
+     * threads if either changed */
+    if (ecs_get_stage_count(world) > 1 && 
+        (world->worker_affinity != (int32_t)desc->affinity ||
+         world->worker_arena_size != desc->arena_size))
+    {
+        flecs_set_threads_internal(world, 1, false);
+    }
+
+    world->worker_affinity = (int32_t)desc->affinity;
+    world->worker_arena_size = desc->arena_size;
+    flecs_set_threads_internal(world, desc->threads, false /* use thread API */);
+error:
+    return;
+}
+
 void ecs_set_task_threads(
     ecs_world_t *world,
     int32_t task_threads)
@@ -59485,6 +61957,166 @@ bool ecs_using_task_threads(
     return world->workers_use_task_api;
 }
 
+void ecs_set_threads_spin(
+    ecs_world_t *world,
+    int32_t spin_count)
+{
+    ecs_poly_assert(world, ecs_world_t);
+    world->sync_spin_max = spin_count;
+}
+
+#endif
+
+/**
+ * @file addons/pipeline/trace.c
+ * @brief Pipeline tracing and export to Chrome trace event format.
+ */
+
+
+#ifdef FLECS_PIPELINE
+
+static
+const char* flecs_trace_kind_str(
+    ecs_trace_kind_t kind)
+{
+    switch(kind) {
+    case EcsTraceFrame: return "frame";
+    case EcsTraceSystem: return "system";
+    case EcsTraceMerge: return "merge";
+    case EcsTraceWait: return "wait";
+    case EcsTraceRebuild: return "pipeline rebuild";
+    }
+    return "unknown";
+}
+
+static
+void flecs_trace_append_str(
+    ecs_strbuf_t *buf,
+    const char *str)
+{
+    ecs_strbuf_appendch(buf, '"');
+    char ch;
+    while ((ch = *str ++)) {
+        if (ch == '"' || ch == '\\') {
+            ecs_strbuf_appendch(buf, '\\');
+        }
+        ecs_strbuf_appendch(buf, ch);
+    }
+    ecs_strbuf_appendch(buf, '"');
+}
+
+static
+void flecs_trace_append_event(
+    const ecs_world_t *world,
+    ecs_strbuf_t *buf,
+    int32_t stage_id,
+    const ecs_trace_event_t *event)
+{
+    ecs_strbuf_list_next(buf);
+    ecs_strbuf_appendlit(buf, "{\"name\":");
+    if (event->kind == EcsTraceSystem) {
+        if (ecs_is_alive(world, event->system)) {
+            char *path = ecs_get_fullpath(world, event->system);
+            flecs_trace_append_str(buf, path);
+            ecs_os_free(path);
+        } else {
+            ecs_strbuf_appendlit(buf, "\"#");
+            ecs_strbuf_appendint(buf, flecs_uto(int64_t, event->system));
+            ecs_strbuf_appendch(buf, '"');
+        }
+    } else {
+        flecs_trace_append_str(buf, flecs_trace_kind_str(event->kind));
+    }
+
+    ecs_strbuf_appendlit(buf, ",\"cat\":");
+    flecs_trace_append_str(buf, flecs_trace_kind_str(event->kind));
+    ecs_strbuf_appendlit(buf, ",\"ph\":\"X\",\"ts\":");
+    ecs_strbuf_appendflt(buf, 
+        (double)(event->start - world->trace_start) / 1000.0, 0);
+    ecs_strbuf_appendlit(buf, ",\"dur\":");
+    ecs_strbuf_appendflt(buf, 
+        (double)(event->end - event->start) / 1000.0, 0);
+    ecs_strbuf_appendlit(buf, ",\"pid\":0,\"tid\":");
+    ecs_strbuf_appendint(buf, stage_id);
+    ecs_strbuf_appendlit(buf, ",\"args\":{\"frame\":");
+    ecs_strbuf_appendint(buf, event->frame);
+    ecs_strbuf_appendlit(buf, "}}");
+}
+
+void ecs_set_trace(
+    ecs_world_t *world,
+    int32_t frames)
+{
+    ecs_poly_assert(world, ecs_world_t);
+    ecs_check(frames >= 0, ECS_INVALID_PARAMETER, NULL);
+    ecs_check(!(world->flags & EcsWorldReadonly), ECS_INVALID_OPERATION, NULL);
+
+    if (!frames) {
+        int32_t i;
+        for (i = 0; i < world->stage_count; i ++) {
+            flecs_trace_fini(&world->stages[i]);
+        }
+    } else if (!world->trace_frames) {
+        world->trace_start = ecs_os_now();
+    }
+
+    world->trace_frames = frames;
+error:
+    return;
+}
+
+char* ecs_trace_to_json(
+    const ecs_world_t *world)
+{
+    ecs_poly_assert(world, ecs_world_t);
+
+    if (!world->trace_frames) {
+        return NULL;
+    }
+
+    ecs_strbuf_t buf = ECS_STRBUF_INIT;
+    ecs_strbuf_appendlit(&buf, "{\"traceEvents\":");
+    ecs_strbuf_list_push(&buf, "[", ",");
+
+    /* Only export events of the last N frames, as the buffer may still contain
+     * events that would be overwritten by the next event. */
+    int64_t first_frame = world->info.frame_count_total - world->trace_frames;
+    int32_t i, count = world->stage_count;
+    for (i = 0; i < count; i ++) {
+        const ecs_trace_buffer_t *trace = &world->stages[i].trace;
+
+        ecs_strbuf_list_next(&buf);
+        ecs_strbuf_appendlit(&buf, 
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":");
+        ecs_strbuf_appendint(&buf, i);
+        if (!i) {
+            ecs_strbuf_appendlit(&buf, ",\"args\":{\"name\":\"main\"}}");
+        } else {
+            ecs_strbuf_appendlit(&buf, ",\"args\":{\"name\":\"worker ");
+            ecs_strbuf_appendint(&buf, i);
+            ecs_strbuf_appendlit(&buf, "\"}}");
+        }
+
+        int32_t e, oldest = trace->head - trace->count;
+        if (oldest < 0) {
+            oldest += trace->size;
+        }
+
+        for (e = 0; e < trace->count; e ++) {
+            const ecs_trace_event_t *event = 
+                &trace->events[(oldest + e) % trace->size];
+            if (event->frame >= first_frame) {
+                flecs_trace_append_event(world, &buf, i, event);
+            }
+        }
+    }
+
+    ecs_strbuf_list_pop(&buf, "]");
+    ecs_strbuf_appendlit(&buf, ",\"displayTimeUnit\":\"ms\"}");
+
+    return ecs_strbuf_get(&buf);
+}
+
 #endif
 
  /**
@@ -66197,8 +68829,15 @@ ecs_entity_t ecs_run_intern(
         it = &pit;
     }
 
+    bool chunked = false;
     if (stage_count > 1 && system_data->multi_threaded) {
-        wit = ecs_worker_iter(it, stage_index, stage_count);
+        if (system_data->chunk_size) {
+            wit = ecs_chunk_iter(it, &system_data->chunk_cursor, 
+                system_data->chunk_size);
+            chunked = true;
+        } else {
+            wit = ecs_worker_iter(it, stage_index, stage_count);
+        }
         it = &wit;
     }
 
@@ -66223,6 +68862,14 @@ ecs_entity_t ecs_run_intern(
         ecs_iter_fini(&qit);
     }
 
+    if (chunked) {
+        /* Last stage to finish resets the cursor for the next run */
+        if (ecs_os_ainc(&system_data->chunk_done) == stage_count) {
+            system_data->chunk_cursor = 0;
+            system_data->chunk_done = 0;
+        }
+    }
+
     if (measure_time) {
         system_data->time_spent += (ecs_ftime_t)ecs_time_measure(&time_start);
     }
@@ -66313,6 +68960,48 @@ void* ecs_system_get_binding_ctx(
     }   
 }
 
+/* Pipelines check the priority version to find out whether systems need to be
+ * reordered, as changing a priority doesn't cause a query rematch. */
+static
+void flecs_system_set_priority(
+    ecs_world_t *world,
+    ecs_system_t *system,
+    int32_t priority)
+{
+    if (system->priority != priority) {
+        system->priority = priority;
+        world->system_priority_version ++;
+    }
+}
+
+void ecs_system_set_priority(
+    ecs_world_t *world,
+    ecs_entity_t system,
+    int32_t priority)
+{
+    ecs_poly_assert(world, ecs_world_t);
+    ecs_check(!(world->flags & EcsWorldReadonly), 
+        ECS_INVALID_WHILE_READONLY, NULL);
+
+    ecs_system_t *s = ecs_poly_get(world, system, ecs_system_t);
+    ecs_check(s != NULL, ECS_INVALID_PARAMETER, "entity is not a system");
+    flecs_system_set_priority(world, s, priority);
+error:
+    return;
+}
+
+int32_t ecs_system_get_priority(
+    const ecs_world_t *world,
+    ecs_entity_t system)
+{
+    const ecs_system_t *s = ecs_poly_get(world, system, ecs_system_t);
+    if (s) {
+        return s->priority;
+    } else {
+        return 0;
+    }
+}
+
 /* System deinitialization */
 static
 void flecs_system_fini(ecs_system_t *sys) {
@@ -66410,6 +69099,8 @@ ecs_entity_t ecs_system_init(
 
         system->multi_threaded = desc->multi_threaded;
         system->no_readonly = desc->no_readonly;
+        system->chunk_size = desc->chunk_size;
+        system->priority = desc->priority;
 
         flecs_system_init_timer(world, entity, desc);
 
@@ -66456,12 +69147,29 @@ ecs_entity_t ecs_system_init(
         if (desc->query.filter.instanced) {
             ECS_BIT_SET(system->query->filter.flags, EcsFilterIsInstanced);
         }
+        bool multi_threaded = system->multi_threaded;
+        bool no_readonly = system->no_readonly;
+        int32_t chunk_size = system->chunk_size;
         if (desc->multi_threaded) {
             system->multi_threaded = desc->multi_threaded;
         }
         if (desc->no_readonly) {
             system->no_readonly = desc->no_readonly;
         }
+        if (desc->chunk_size) {
+            system->chunk_size = desc->chunk_size;
+        }
+        if (desc->priority) {
+            flecs_system_set_priority(world, system, desc->priority);
+        }
+
+        /* Pipelines copy these into their schedules, which must be rebuilt */
+        if (multi_threaded != system->multi_threaded ||
+            no_readonly != system->no_readonly ||
+            chunk_size != system->chunk_size)
+        {
+            world->system_version ++;
+        }
 
         flecs_system_init_timer(world, entity, desc);
     }
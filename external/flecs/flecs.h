@@ -2003,6 +2003,25 @@ void* (*ecs_os_api_thread_join_t)(
 typedef
 ecs_os_thread_id_t (*ecs_os_api_thread_self_t)(void);
 
+/** Pin the calling thread to a logical cpu. Returns 0 if successful. */
+typedef
+int (*ecs_os_api_thread_set_affinity_t)(
+    int32_t cpu);
+
+/* Cpu topology */
+typedef struct ecs_os_cpu_t {
+    int32_t id;                 /**< Logical cpu id */
+    int32_t core;               /**< Physical core id, unique within package */
+    int32_t package;            /**< Physical package (socket) id */
+} ecs_os_cpu_t;
+
+/** Get the online logical cpus. Writes at most count cpus to the cpus array,
+ * and returns the total number of online cpus, or 0 if unknown. */
+typedef
+int32_t (*ecs_os_api_cpu_topology_t)(
+    ecs_os_cpu_t *cpus,
+    int32_t count);
+
 /* Tasks */
 typedef
 ecs_os_thread_t (*ecs_os_api_task_new_t)(
@@ -2129,6 +2148,8 @@ typedef struct ecs_os_api_t {
     ecs_os_api_thread_new_t thread_new_;
     ecs_os_api_thread_join_t thread_join_;
     ecs_os_api_thread_self_t thread_self_;
+    ecs_os_api_thread_set_affinity_t thread_set_affinity_;
+    ecs_os_api_cpu_topology_t cpu_topology_;
 
     /* Tasks */
     ecs_os_api_thread_new_t task_new_;
@@ -2302,6 +2323,8 @@ void ecs_os_set_api_defaults(void);
 #define ecs_os_thread_new(callback, param) ecs_os_api.thread_new_(callback, param)
 #define ecs_os_thread_join(thread) ecs_os_api.thread_join_(thread)
 #define ecs_os_thread_self() ecs_os_api.thread_self_()
+#define ecs_os_thread_set_affinity(cpu) ecs_os_api.thread_set_affinity_(cpu)
+#define ecs_os_cpu_topology(cpus, count) ecs_os_api.cpu_topology_(cpus, count)
 
 /* Tasks */
 #define ecs_os_task_new(callback, param) ecs_os_api.task_new_(callback, param)
@@ -2425,6 +2448,10 @@ bool ecs_os_has_threading(void);
 FLECS_API
 bool ecs_os_has_task_support(void);
 
+/** Are thread affinity functions available? */
+FLECS_API
+bool ecs_os_has_affinity(void);
+
 /** Are time functions available? */
 FLECS_API
 bool ecs_os_has_time(void);
@@ -3163,6 +3190,15 @@ typedef struct ecs_worker_iter_t {
     int32_t count;
 } ecs_worker_iter_t;
 
+/* Chunk-iterator specific data */
+typedef struct ecs_chunk_iter_t {
+    int32_t *cursor;  /* Shared cursor from which chunks are claimed */
+    int32_t size;     /* Number of entities per chunk */
+    int32_t first;    /* Index of first chunk in current result */
+    int32_t count;    /* Number of chunks in current result */
+    int32_t offset;   /* Offset applied to field pointers of current result */
+} ecs_chunk_iter_t;
+
 /* Convenience struct to iterate table array for id */
 typedef struct ecs_table_cache_iter_t {
     struct ecs_table_cache_hdr_t *cur, *next;
@@ -3279,6 +3315,7 @@ typedef struct ecs_iter_private_t {
         ecs_snapshot_iter_t snapshot;
         ecs_page_iter_t page;
         ecs_worker_iter_t worker;
+        ecs_chunk_iter_t chunk;
     } iter;                       /* Iterator specific data */
 
     void *entity_iter;            /* Filter applied after matching a table */
@@ -3914,6 +3951,7 @@ typedef struct ecs_world_info_t {
     ecs_ftime_t world_time_total;     /**< Time elapsed in simulation */
     ecs_ftime_t world_time_total_raw; /**< Time elapsed in simulation (no scaling) */
     ecs_ftime_t rematch_time_total;   /**< Time spent on query rematching */
+    ecs_ftime_t pipeline_build_time_total; /**< Time spent on (re)building pipelines */
     
     int64_t frame_count_total;        /**< Total number of frames */
     int64_t merge_count_total;        /**< Total number of merges */
@@ -3947,6 +3985,8 @@ typedef struct ecs_world_info_t {
         int64_t discard_count;         /**< commands discarded, happens when entity is no longer alive when running the command */
         int64_t batched_entity_count;  /**< entities for which commands were batched */
         int64_t batched_command_count; /**< commands batched */
+        int64_t coalesced_count;       /**< commands skipped because a later command made them redundant */
+        int64_t applied_count;         /**< commands applied by worker threads before the merge */
     } cmd;
 
     const char *name_prefix;          /**< Value set by ecs_set_name_prefix. Used
@@ -4284,6 +4324,7 @@ FLECS_API extern const ecs_entity_t EcsEmpty;
 
 /* Pipeline module tags */
 FLECS_API extern const ecs_entity_t ecs_id(EcsPipeline);
+FLECS_API extern const ecs_entity_t ecs_id(EcsPhaseSchedule);
 FLECS_API extern const ecs_entity_t EcsOnStart;
 FLECS_API extern const ecs_entity_t EcsPreFrame;
 FLECS_API extern const ecs_entity_t EcsOnLoad;
@@ -7730,6 +7771,44 @@ FLECS_API
 bool ecs_worker_next(
     ecs_iter_t *it);
 
+/** Create a chunk iterator.
+ * Chunk iterators divide matched entities across N resources (usually threads)
+ * dynamically. Each resource claims the next chunk of 'size' entities from a
+ * cursor that is shared between the resources, which keeps all resources busy
+ * when tables are small or when the cost per entity is uneven.
+ * 
+ * All resources must create their iterator from the same query, and must use
+ * the same cursor and chunk size. The cursor must be set to 0 before any of the
+ * resources starts iterating, and may not be reused until all resources are 
+ * done iterating.
+ * 
+ * The iterator must be iterated with ecs_chunk_next.
+ * 
+ * A chunk iterator acts as a passthrough for data exposed by the parent
+ * iterator, so that any data provided by the parent will also be provided by
+ * the chunk iterator.
+ * 
+ * @param it The source iterator.
+ * @param cursor The shared cursor.
+ * @param size The number of entities per chunk.
+ * @return A chunk iterator.
+ */
+FLECS_API
+ecs_iter_t ecs_chunk_iter(
+    const ecs_iter_t *it,
+    int32_t *cursor,
+    int32_t size);
+
+/** Progress a chunk iterator.
+ * Progresses an iterator created by ecs_chunk_iter.
+ * 
+ * @param it The iterator.
+ * @return true if iterator has more results, false if not.
+ */
+FLECS_API
+bool ecs_chunk_next(
+    ecs_iter_t *it);
+
 /** Obtain data for a query field.
  * This operation retrieves a pointer to an array of data that belongs to the
  * term in the query. The index refers to the location of the term in the query,
@@ -10774,14 +10853,66 @@ void FlecsTimerImport(
 
 #endif
 
+/** Component with scheduling parameters for a phase.
+ * Systems in a phase with an interval only run once every interval frames. When
+ * the pipeline has a frame budget, phases with a priority class are deferred
+ * while the frame is over budget. Phases with a higher priority class are 
+ * deferred earlier in the frame. Whether a phase runs is decided when its 
+ * first system is reached. A deferred phase runs in the first frame that has 
+ * budget left, or after it was deferred 4 frames in a row. Changing a schedule
+ * rebuilds the pipeline. */
+typedef struct EcsPhaseSchedule {
+    int32_t interval;           /**< Run phase every N frames, 0 for every frame */
+    int32_t priority_class;     /**< 0 is never deferred, higher is deferred first */
+} EcsPhaseSchedule;
+
 /* Pipeline descriptor (used with ecs_pipeline_init) */
 typedef struct ecs_pipeline_desc_t {
     /* Existing entity to associate with pipeline (optional) */
     ecs_entity_t entity;
     
     /* Query descriptor. The first term of the query must match the EcsSystem
-     * component. */
+     * component. When the query doesn't specify order_by, systems are ordered
+     * by cascade depth, system priority and entity id. */
     ecs_query_desc_t query;
+
+    /* When set, multi threaded systems between two sync points are scheduled
+     * as a dependency graph. Instead of splitting each system across all 
+     * workers, systems that don't access conflicting components run at the
+     * same time, each on a single worker. */
+    bool parallel_systems;
+
+    /* When set, threads remove redundant commands from their command queue 
+     * before a sync point, such as a set that is followed by another set for 
+     * the same component, or an add that is followed by a remove. This reduces
+     * the work done by the merge, which runs on the main thread. OnSet hooks 
+     * and observers are only invoked for the last of coalesced set commands. 
+     * Coalesced commands are counted by the coalesced_count command counter, 
+     * and not by discard_count. */
+    bool coalesce_commands;
+
+    /* When set, worker threads apply part of the commands of a multi threaded
+     * sync point in parallel before the merge. Commands are partitioned by 
+     * entity: a thread only applies commands of entities that have no commands
+     * in the queues of other threads. Only commands that leave the entity in
+     * its table and don't invoke hooks or observers are applied, such as a set
+     * for a component the entity already has without an OnSet hook or 
+     * observer. Commands that move entities to other tables are merged by the 
+     * main thread one queue after another, as creating tables and updating the
+     * entity index is not thread safe. When a queue contains commands that 
+     * aren't tracked per entity, such as deletes and events, nothing is 
+     * applied in parallel. Applied commands are counted by the applied_count
+     * command counter. */
+    bool parallel_merge;
+
+    /* Time in seconds the pipeline may spend in a frame. When the budget is 
+     * used up, phases with a priority class are deferred to a later frame (see
+     * EcsPhaseSchedule). When 0, phases are never deferred. The time spent is
+     * checked at the start of each phase. Because workers run all systems
+     * between two sync points without returning to the main thread, a phase 
+     * with a priority class starts after a sync point when its systems are 
+     * multi threaded. */
+    ecs_ftime_t frame_budget;
 } ecs_pipeline_desc_t;
 
 /** Create a custom pipeline.
@@ -10893,6 +11024,49 @@ void ecs_set_threads(
     ecs_world_t *world,
     int32_t threads);
 
+/** Placement of worker threads on cpus. */
+typedef enum ecs_thread_affinity_t {
+    EcsAffinityNone,            /**< Threads are placed by the OS scheduler */
+    EcsAffinityCore,            /**< Pin worker N to the Nth online cpu */
+    EcsAffinityTopology         /**< Pin workers to separate physical cores, filling a package before the next */
+} ecs_thread_affinity_t;
+
+/** Worker thread options, used by ecs_set_threads_w_desc. */
+typedef struct ecs_threads_desc_t {
+    /** Number of threads, including the main thread. */
+    int32_t threads;
+
+    /** Placement of worker threads. Cpus are assigned in order, skipping the
+     * first cpu which is left for the main thread. Workers for which no cpu is
+     * left are not pinned. The main thread is not pinned. */
+    ecs_thread_affinity_t affinity;
+
+    /** Bytes of command storage each worker reserves when it starts, for the
+     * command queue and deferred component values. Command storage is reused
+     * after each merge, so a worker that stays within the reserved size does
+     * not allocate while running the pipeline. This only covers command 
+     * storage: there is no per frame arena that is reset in bulk, and 
+     * iterators don't allocate scratch memory from it. */
+    ecs_size_t arena_size;
+} ecs_threads_desc_t;
+
+/** Set number of worker threads, with placement and arena options.
+ * Same as ecs_set_threads, but also configures how worker threads are pinned
+ * to cpus, and how much command storage they reserve. Pinning requires the
+ * thread_set_affinity_ function of the OS API, and topology aware placement
+ * requires cpu_topology_. The builtin POSIX implementation provides both on 
+ * Linux, where the topology is read from sysfs. If the cpus are not known,
+ * worker threads are not pinned. Running threads are restarted if placement or
+ * arena options change.
+ *
+ * @param world The world.
+ * @param desc Thread options.
+ */
+FLECS_API
+void ecs_set_threads_w_desc(
+    ecs_world_t *world,
+    const ecs_threads_desc_t *desc);
+
 /** Set number of worker task threads.
  * ecs_set_task_threads is similar to ecs_set_threads, except threads are treated
  * as short-lived tasks and will be created and joined around each update of the world. 
@@ -10916,6 +11090,43 @@ FLECS_API
 bool ecs_using_task_threads(
     ecs_world_t *world);
 
+/** Set number of iterations threads spin on a sync point before blocking.
+ * When set to a value larger than 0, the main thread and workers spin on sync
+ * points before blocking on a condition variable. This reduces wake-up latency
+ * for pipelines with many short sync points, at the cost of CPU time. The
+ * actual number of iterations adapts to how long sync points take, and never
+ * exceeds spin_count. The default is 0, which blocks immediately. */
+FLECS_API
+void ecs_set_threads_spin(
+    ecs_world_t *world,
+    int32_t spin_count);
+
+/** Enable tracing of pipeline execution.
+ * When enabled, each stage records when systems, merges, sync point waits and
+ * pipeline rebuilds start and end. Events are kept for the last N frames, and
+ * can be exported with ecs_trace_to_json. Tracing adds a timestamp read per
+ * system, and is disabled by default.
+ *
+ * @param world The world.
+ * @param frames The number of frames to keep events for, 0 disables tracing.
+ */
+FLECS_API
+void ecs_set_trace(
+    ecs_world_t *world,
+    int32_t frames);
+
+/** Serialize recorded trace events to JSON.
+ * The output uses the Chrome trace event format, and can be loaded in 
+ * chrome://tracing or Perfetto. Each stage is shown as a separate thread. This
+ * operation must not be called while the world is progressing.
+ *
+ * @param world The world.
+ * @return JSON string with trace events, or NULL if tracing is disabled. 
+ */
+FLECS_API
+char* ecs_trace_to_json(
+    const ecs_world_t *world);
+
 ////////////////////////////////////////////////////////////////////////////////
 //// Module
 ////////////////////////////////////////////////////////////////////////////////
@@ -11026,6 +11237,16 @@ typedef struct ecs_system_desc_t {
     /** If true, system will have access to the actual world. Cannot be true at the
      * same time as multi_threaded. */
     bool no_readonly;
+
+    /** When set for a multi_threaded system, threads claim chunks of this many
+     * entities from a shared cursor until all entities are processed, instead
+     * of each thread processing a fixed slice of every table. */
+    int32_t chunk_size;
+
+    /** Order of system within its phase. Systems with a lower priority run 
+     * before systems with a higher priority. Systems with the same priority
+     * run in order of entity id. Ignored by pipelines with a custom order_by. */
+    int32_t priority;
 } ecs_system_desc_t;
 
 /** Create a system */
@@ -11213,6 +11434,32 @@ void* ecs_system_get_binding_ctx(
     const ecs_world_t *world,
     ecs_entity_t system);
 
+/** Set system priority.
+ * Changes the order of a system within its phase, see ecs_system_desc_t. The
+ * pipeline is reordered at the start of the next frame, which only reorders 
+ * the systems and doesn't rematch the pipeline query.
+ *
+ * @param world The world.
+ * @param system The system.
+ * @param priority The new priority.
+ */
+FLECS_API
+void ecs_system_set_priority(
+    ecs_world_t *world,
+    ecs_entity_t system,
+    int32_t priority);
+
+/** Get system priority.
+ *
+ * @param world The world.
+ * @param system The system.
+ * @return The priority, or 0 if the entity is not a system.
+ */
+FLECS_API
+int32_t ecs_system_get_priority(
+    const ecs_world_t *world,
+    ecs_entity_t system);
+
 FLECS_API
 void FlecsSystemImport(
     ecs_world_t *world);
@@ -11320,6 +11567,8 @@ typedef struct ecs_world_stats_t {
         ecs_metric_t discard_count;
         ecs_metric_t batched_entity_count;
         ecs_metric_t batched_count;
+        ecs_metric_t coalesced_count;
+        ecs_metric_t applied_count;
     } commands;
 
     /* Frame data */
@@ -11405,13 +11654,22 @@ typedef struct ecs_system_stats_t {
     ecs_query_stats_t query;
 } ecs_system_stats_t;
 
-/** Statistics for sync point */
+/** Statistics for sync point.
+ * Wait times are only recorded while system time is measured, see 
+ * ecs_measure_system_time. */
 typedef struct ecs_sync_stats_t {
     int64_t first_;
     ecs_metric_t time_spent;
     ecs_metric_t commands_enqueued;
+    ecs_metric_t main_wait_time;   /**< Time main thread waited for workers */
+    ecs_metric_t worker_wait_time; /**< Time workers waited, summed */
+    ecs_metric_t deferred_count;   /**< Phases deferred by frame budget */
     int64_t last_;
 
+    /** Vector with total time each stage waited on the sync point (double).
+     * Element 0 is the main thread. */
+    ecs_vec_t stage_wait_time;
+
     int32_t system_count;
     bool multi_threaded;
     bool no_readonly;
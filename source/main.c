@@ -2,26 +2,6 @@
 
 #include "flecs.h"
 
-typedef struct
-{
-	unsigned int priority;
-} PhasePriority;
-
-/*
- * this is just the default flecs_entity_compare
- * 	but now we're testing on the priority component
- *
- * a lower priority value means a higher priority
- * 	0 is highest priority
- */
-int priority_compare (ecs_entity_t e1, const void* pointer1, ecs_entity_t e2, const void* pointer2)
-{
-	unsigned int priority1 = ((PhasePriority*) pointer1)->priority;
-	unsigned int priority2 = ((PhasePriority*) pointer2)->priority;
-
-	return (priority1 > priority2) - (priority1 < priority2);
-}
-
 void print_system (ecs_iter_t* it)
 {
 	printf ("running: %s\n", ecs_get_name (it->world, it->system));
@@ -103,7 +83,7 @@ int main (void)
 	 * 		which is lower than a system that should come after it
 	 * 			the system with the lower entity id will run first
 	 *
-	 * 	avoiding this will require the use of order_by in the pipeline query
+	 * 	avoiding this will require setting a priority on the system
 	 * 		demonstrated later
 	 */
 
@@ -197,8 +177,12 @@ int main (void)
 
 	world = ecs_init ();
 
-	ECS_COMPONENT (world, PhasePriority);
-
+	// without an order_by in the query
+	// 	the pipeline orders systems within a phase by their priority
+	// 		and then by their entity id
+	//
+	// a lower priority value means a higher priority
+	// 	0 is the default
 	pipeline = ecs_pipeline(world,
 	{
 		.query =
@@ -208,11 +192,8 @@ int main (void)
 				{.id = EcsSystem},  // mandatory
 				{.id = EcsPhase, .src.flags = EcsCascade, .src.trav = EcsDependsOn},
 				{.id = EcsDisabled, .src.flags = EcsUp, .src.trav = EcsDependsOn, .oper = EcsNot},
-				{.id = EcsDisabled, .src.flags = EcsUp, .src.trav = EcsChildOf, .oper = EcsNot},
-				{.id = ecs_id (PhasePriority)}
-			},
-			.order_by = priority_compare,
-			.order_by_component = ecs_id (PhasePriority)
+				{.id = EcsDisabled, .src.flags = EcsUp, .src.trav = EcsChildOf, .oper = EcsNot}
+			}
 		}
 	});
 
@@ -231,7 +212,7 @@ int main (void)
 	 * add systems out of order
 	 * 	so we can see them running in order
 	 */
-	ecs_entity_t system_c = ecs_system (world,
+	ecs_system (world,
 	{
 		.entity = ecs_entity (world,
 		{
@@ -240,7 +221,6 @@ int main (void)
 		}),
 		.callback = print_system
 	});
-	ecs_set (world, system_c, PhasePriority, {0});
 
 	/*
 	 * 'system a' and 'system b' will both be run in phase0
@@ -248,18 +228,18 @@ int main (void)
 	 * 	but we want it to run _after_ 'system a'
 	 * 	so we give 'system b' a lower priority
 	 */
-	ecs_entity_t system_b = ecs_system (world,
+	ecs_system (world,
 	{
 		.entity = ecs_entity (world,
 		{
 			.name = "system b",
 			.add = {ecs_dependson (phase0), phase0}
 		}),
-		.callback = print_system
+		.callback = print_system,
+		.priority = 1
 	});
-	ecs_set (world, system_b, PhasePriority, {1});
 
-	ecs_entity_t system_a = ecs_system (world,
+	ecs_system (world,
 	{
 		.entity = ecs_entity (world,
 		{
@@ -268,7 +248,6 @@ int main (void)
 		}),
 		.callback = print_system
 	});
-	ecs_set (world, system_a, PhasePriority, {0});
 
 	ecs_progress (world, 0);
 
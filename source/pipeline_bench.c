@@ -0,0 +1,741 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "flecs.h"
+
+/*
+ * pipeline benchmark
+ *
+ * generates synthetic pipelines and measures how fast they are scheduled
+ * 	every setup is printed as a single line of json
+ * 		so results can be diffed or collected by scripts
+ *
+ * run without arguments to run the default set of setups
+ * 	pass --check to verify scheduling behavior instead of measuring it
+ * 	or pass options to run a single setup:
+ *
+ * 	--phases N      number of phases
+ * 	--depth N       anonymous DependsOn phases between two phases
+ * 	--systems N     systems per phase
+ * 	--overlap F     fraction of systems that write to the stage (0..1)
+ * 	                	systems that read the written component after them
+ * 	                	force a merge
+ * 	--threads N     number of worker threads
+ * 	--entities N    number of entities the systems iterate
+ * 	--frames N      number of frames to measure
+ * 	--chunk N       entities per chunk claimed by threads, 0 to split tables
+ * 	--parallel      schedule non-conflicting systems in parallel
+ * 	--coalesce      coalesce redundant commands before merging
+ * 	--parallel-merge
+ * 	                apply commands that don't move entities on the workers
+ * 	--pin           pin worker threads to physical cores
+ * 	--arena N       bytes of command storage reserved per worker
+ * 	--budget N      frame budget in microseconds
+ * 	                	phases in the second half get a priority class
+ * 	                	and are deferred while the frame is over budget
+ * 	--seed N        seed for generating the pipeline
+ */
+
+#define BENCH_COMPONENT_COUNT 8
+#define BENCH_WARMUP_FRAMES 10
+#define BENCH_TOGGLE_COUNT 10
+#define BENCH_CHECK_FRAMES 15
+#define BENCH_MAX_DEFERRALS 4
+
+typedef struct
+{
+	int phases;
+	int depth;
+	int systems;
+	float overlap;
+	int threads;
+	int entities;
+	int frames;
+	int chunk;
+	bool parallel;
+	bool coalesce;
+	bool parallel_merge;
+	bool pin;
+	int arena;
+	int budget;
+	unsigned int seed;
+} bench_setup;
+
+typedef struct
+{
+	ecs_entity_t system;
+	ecs_entity_t read;
+	ecs_entity_t write;
+	ecs_entity_t staged;
+} bench_system_ctx;
+
+typedef struct
+{
+	char name;
+	char* log;
+} bench_check_ctx;
+
+typedef struct
+{
+	double frame_p50;
+	double frame_p90;
+	double frame_p99;
+	double frame_max;
+	double build_time;
+	double toggle_time;
+	double toggle_cached_time;
+	double priority_time;
+	double merge_time;
+	double deferred;
+	double systems_per_sec;
+	int64_t sync_points;
+	int64_t builds;
+} bench_result;
+
+static unsigned int bench_random (unsigned int* state)
+{
+	// xorshift, so setups generate the same pipeline on every platform
+	unsigned int x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static void bench_system (ecs_iter_t* it)
+{
+	bench_system_ctx* ctx = it->ctx;
+	float* read = ecs_field_w_size (it, sizeof (float), 1);
+	float* write = ecs_field_w_size (it, sizeof (float), 2);
+
+	for (int i = 0; i < it->count; i++)
+	{
+		write[i] += read[i] * 0.5f;
+	}
+
+	// writing to the stage is what forces the pipeline to merge
+	if (ctx->staged)
+	{
+		for (int i = 0; i < it->count; i++)
+		{
+			float value = read[i];
+			ecs_set_id (it->world, it->entities[i], ctx->staged, sizeof (float), &value);
+		}
+	}
+}
+
+static int bench_compare_double (const void* pointer1, const void* pointer2)
+{
+	double value1 = *(const double*) pointer1;
+	double value2 = *(const double*) pointer2;
+
+	return (value1 > value2) - (value1 < value2);
+}
+
+static double bench_percentile (double* sorted, int count, double percentile)
+{
+	// nearest rank
+	int index = (int) (percentile * (double) count + 0.999999) - 1;
+
+	if (index < 0)
+	{
+		index = 0;
+	}
+	if (index >= count)
+	{
+		index = count - 1;
+	}
+
+	return sorted[index];
+}
+
+static ecs_entity_t bench_add_phase (ecs_world_t* world, ecs_entity_t anonymous_phase)
+{
+	ecs_entity_t phase = ecs_new_w_id (world, EcsPhase);
+	ecs_add_pair (world, phase, EcsDependsOn, anonymous_phase);
+	return phase;
+}
+
+static void bench_add_systems (ecs_world_t* world, const bench_setup* setup, ecs_entity_t phase, ecs_entity_t* components, bench_system_ctx* contexts, unsigned int* random)
+{
+	for (int i = 0; i < setup->systems; i++)
+	{
+		bench_system_ctx* ctx = &contexts[i];
+		ctx->read = components[bench_random (random) % BENCH_COMPONENT_COUNT];
+		ctx->write = components[bench_random (random) % BENCH_COMPONENT_COUNT];
+		ctx->staged = 0;
+
+		if ((float) (bench_random (random) % 10000) < setup->overlap * 10000.0f)
+		{
+			ctx->staged = components[bench_random (random) % BENCH_COMPONENT_COUNT];
+		}
+
+		ecs_system_desc_t desc =
+		{
+			.entity = ecs_entity (world,
+			{
+				.add = {ecs_dependson (phase), phase}
+			}),
+			.query.filter.terms =
+			{
+				{.id = ctx->read, .inout = EcsIn},
+				{.id = ctx->write, .inout = ctx->write == ctx->read ? EcsIn : EcsInOut}
+			},
+			.callback = bench_system,
+			.ctx = ctx,
+			.multi_threaded = true,
+			.chunk_size = setup->chunk
+		};
+
+		// tells the pipeline the system writes to the stage
+		if (ctx->staged)
+		{
+			desc.query.filter.terms[2] = (ecs_term_t) {.id = ctx->staged, .src.flags = EcsIsEntity, .inout = EcsOut};
+		}
+
+		ctx->system = ecs_system_init (world, &desc);
+	}
+}
+
+static int64_t bench_deferred_count (ecs_world_t* world, ecs_entity_t pipeline)
+{
+	// a fresh stats struct records the totals of the pipeline at index 0
+	int64_t count = 0;
+	ecs_pipeline_stats_t stats = {0};
+	ecs_pipeline_stats_get (world, pipeline, &stats);
+
+	ecs_sync_stats_t* sync_points = ecs_vec_first_t (&stats.sync_points, ecs_sync_stats_t);
+	for (int i = 0; i < ecs_vec_count (&stats.sync_points); i++)
+	{
+		count += (int64_t) sync_points[i].deferred_count.counter.value[0];
+	}
+
+	ecs_pipeline_stats_fini (&stats);
+	return count;
+}
+
+static double bench_frame (ecs_world_t* world)
+{
+	ecs_time_t start = {0};
+	ecs_time_measure (&start);
+	ecs_progress (world, 0);
+	return ecs_time_measure (&start);
+}
+
+static bench_result bench_run (const bench_setup* setup)
+{
+	bench_result result = {0};
+	unsigned int random = setup->seed ? setup->seed : 1;
+
+	ecs_world_t* world = ecs_init ();
+	ecs_measure_frame_time (world, true);
+	ecs_measure_system_time (world, true);
+
+	ecs_entity_t pipeline = ecs_pipeline (world,
+	{
+		.query =
+		{
+			.filter.terms =
+			{
+				{.id = EcsSystem},  // mandatory
+				{.id = EcsPhase, .src.flags = EcsCascade, .src.trav = EcsDependsOn},
+				{.id = EcsDisabled, .src.flags = EcsUp, .src.trav = EcsDependsOn, .oper = EcsNot},
+				{.id = EcsDisabled, .src.flags = EcsUp, .src.trav = EcsChildOf, .oper = EcsNot}
+			}
+		},
+		.parallel_systems = setup->parallel,
+		.coalesce_commands = setup->coalesce,
+		.parallel_merge = setup->parallel_merge,
+		.frame_budget = (ecs_ftime_t) ((double) setup->budget * 1e-6)
+	});
+
+	ecs_set_pipeline (world, pipeline);
+	ecs_set_threads_w_desc (world, &(ecs_threads_desc_t) {
+		.threads = setup->threads,
+		.affinity = setup->pin ? EcsAffinityTopology : EcsAffinityNone,
+		.arena_size = setup->arena
+	});
+
+	ecs_entity_t components[BENCH_COMPONENT_COUNT];
+	for (int i = 0; i < BENCH_COMPONENT_COUNT; i++)
+	{
+		components[i] = ecs_component_init (world, &(ecs_component_desc_t)
+		{
+			.type = {.size = ECS_SIZEOF (float), .alignment = ECS_ALIGNOF (float)}
+		});
+	}
+
+	for (int i = 0; i < setup->entities; i++)
+	{
+		ecs_entity_t entity = ecs_new_id (world);
+		float value = (float) i;
+		for (int c = 0; c < BENCH_COMPONENT_COUNT; c++)
+		{
+			ecs_set_id (world, entity, components[c], sizeof (float), &value);
+		}
+	}
+
+	// the middle phase has an alternate, toggling between the two measures
+	// 	how expensive it is to change the set of enabled systems
+	int phase_count = setup->phases;
+	int toggle_index = phase_count / 2;
+	bench_system_ctx* contexts = calloc ((size_t) ((phase_count + 1) * setup->systems), sizeof (bench_system_ctx));
+	ecs_entity_t anonymous_phase = 0;
+	ecs_entity_t toggle_phase = 0;
+	ecs_entity_t alternate_phase = 0;
+
+	for (int p = 0; p < phase_count; p++)
+	{
+		// like main.c, phases depend on a chain of anonymous phases
+		// 	so a phase can be disabled without disabling the phases after it
+		for (int d = 0; d < setup->depth; d++)
+		{
+			anonymous_phase = anonymous_phase ? ecs_new_w_pair (world, EcsDependsOn, anonymous_phase) : ecs_new (world, 0);
+		}
+
+		ecs_entity_t phase = bench_add_phase (world, anonymous_phase);
+		if (setup->budget && p >= phase_count / 2)
+		{
+			ecs_set (world, phase, EcsPhaseSchedule, {.priority_class = 1 + p % 3});
+		}
+		bench_add_systems (world, setup, phase, components, &contexts[p * setup->systems], &random);
+
+		if (p == toggle_index)
+		{
+			toggle_phase = phase;
+			alternate_phase = bench_add_phase (world, anonymous_phase);
+			bench_add_systems (world, setup, alternate_phase, components, &contexts[phase_count * setup->systems], &random);
+			ecs_enable (world, alternate_phase, false);
+		}
+	}
+
+	const ecs_world_info_t* info = ecs_get_world_info (world);
+
+	// first frame builds the pipeline
+	double build_start = (double) info->pipeline_build_time_total;
+	bench_frame (world);
+	result.build_time = (double) info->pipeline_build_time_total - build_start;
+
+	for (int i = 0; i < BENCH_WARMUP_FRAMES; i++)
+	{
+		bench_frame (world);
+	}
+
+	double* frame_times = calloc ((size_t) setup->frames, sizeof (double));
+	double merge_start = (double) info->merge_time_total;
+	int64_t merge_count_start = info->merge_count_total;
+	int64_t systems_start = info->systems_ran_frame;
+	int64_t deferred_start = bench_deferred_count (world, pipeline);
+	double total_time = 0;
+
+	for (int i = 0; i < setup->frames; i++)
+	{
+		frame_times[i] = bench_frame (world);
+		total_time += frame_times[i];
+	}
+
+	result.merge_time = ((double) info->merge_time_total - merge_start) / setup->frames;
+	result.sync_points = (info->merge_count_total - merge_count_start) / setup->frames;
+	result.deferred = (double) (bench_deferred_count (world, pipeline) - deferred_start) / setup->frames;
+	result.systems_per_sec = total_time > 0 ? (double) (info->systems_ran_frame - systems_start) / total_time : 0;
+
+	qsort (frame_times, (size_t) setup->frames, sizeof (double), bench_compare_double);
+	result.frame_p50 = bench_percentile (frame_times, setup->frames, 0.50);
+	result.frame_p90 = bench_percentile (frame_times, setup->frames, 0.90);
+	result.frame_p99 = bench_percentile (frame_times, setup->frames, 0.99);
+	result.frame_max = frame_times[setup->frames - 1];
+
+	// first toggle builds the alternate schedule
+	// 	toggling back and forth after that can reuse schedules
+	for (int i = 0; i < BENCH_TOGGLE_COUNT; i++)
+	{
+		bool alternate = (i % 2) == 0;
+		double toggle_start = (double) info->pipeline_build_time_total;
+
+		ecs_enable (world, toggle_phase, !alternate);
+		ecs_enable (world, alternate_phase, alternate);
+		bench_frame (world);
+
+		double toggle_time = (double) info->pipeline_build_time_total - toggle_start;
+		if (!i)
+		{
+			result.toggle_time = toggle_time;
+		}
+		else
+		{
+			result.toggle_cached_time += toggle_time / (BENCH_TOGGLE_COUNT - 1);
+		}
+	}
+
+	// reversing the systems of a phase only reorders the pipeline
+	double priority_start = (double) info->pipeline_build_time_total;
+	for (int i = 0; i < setup->systems; i++)
+	{
+		ecs_system_set_priority (world, contexts[toggle_index * setup->systems + i].system, setup->systems - i);
+	}
+	bench_frame (world);
+	result.priority_time = (double) info->pipeline_build_time_total - priority_start;
+
+	result.builds = info->pipeline_build_count_total;
+
+	free (frame_times);
+	ecs_fini (world);
+	free (contexts);
+
+	return result;
+}
+
+static void bench_print (const bench_setup* setup, const bench_result* result)
+{
+	// times are in microseconds
+	printf ("{\"phases\": %d, \"depth\": %d, \"systems_per_phase\": %d, \"overlap\": %.2f, "
+		"\"threads\": %d, \"entities\": %d, \"parallel\": %s, \"coalesce\": %s, \"parallel_merge\": %s, \"pin\": %s, \"arena\": %d, \"chunk\": %d, \"budget\": %d, \"frames\": %d, "
+		"\"frame_us_p50\": %.3f, \"frame_us_p90\": %.3f, \"frame_us_p99\": %.3f, \"frame_us_max\": %.3f, "
+		"\"build_us\": %.3f, \"toggle_us\": %.3f, \"toggle_cached_us\": %.3f, \"priority_us\": %.3f, "
+		"\"merge_us\": %.3f, \"sync_points\": %lld, \"deferred_per_frame\": %.2f, \"builds\": %lld, \"systems_per_sec\": %.0f}\n",
+		setup->phases, setup->depth, setup->systems, (double) setup->overlap,
+		setup->threads, setup->entities, setup->parallel ? "true" : "false", setup->coalesce ? "true" : "false",
+		setup->parallel_merge ? "true" : "false", setup->pin ? "true" : "false", setup->arena, setup->chunk, setup->budget, setup->frames,
+		result->frame_p50 * 1e6, result->frame_p90 * 1e6, result->frame_p99 * 1e6, result->frame_max * 1e6,
+		result->build_time * 1e6, result->toggle_time * 1e6, result->toggle_cached_time * 1e6, result->priority_time * 1e6,
+		result->merge_time * 1e6, (long long) result->sync_points, result->deferred, (long long) result->builds,
+		result->systems_per_sec);
+	fflush (stdout);
+}
+
+static void bench_check_system (ecs_iter_t* it)
+{
+	bench_check_ctx* ctx = it->ctx;
+	size_t length = strlen (ctx->log);
+	ctx->log[length] = ctx->name;
+}
+
+static ecs_entity_t bench_check_add_system (ecs_world_t* world, ecs_entity_t phase, bench_check_ctx* ctx)
+{
+	return ecs_system_init (world, &(ecs_system_desc_t)
+	{
+		.entity = ecs_entity (world,
+		{
+			.add = {ecs_dependson (phase), phase}
+		}),
+		.callback = bench_check_system,
+		.ctx = ctx
+	});
+}
+
+static int bench_check_order (void)
+{
+	int failures = 0;
+	char log[16] = {0};
+	bench_check_ctx contexts[3] = {{'A', log}, {'B', log}, {'C', log}};
+
+	ecs_world_t* world = ecs_init ();
+	ecs_entity_t systems[3];
+	for (int i = 0; i < 3; i++)
+	{
+		systems[i] = bench_check_add_system (world, EcsOnUpdate, &contexts[i]);
+	}
+
+	ecs_progress (world, 0);
+	if (strcmp (log, "ABC"))
+	{
+		fprintf (stderr, "check failed: systems ran as %s, expected ABC\n", log);
+		failures++;
+	}
+
+	// a lower priority moves the last system to the front of its phase
+	ecs_system_set_priority (world, systems[2], -1);
+	memset (log, 0, sizeof (log));
+	ecs_progress (world, 0);
+	if (strcmp (log, "CAB"))
+	{
+		fprintf (stderr, "check failed: systems ran as %s after priority change, expected CAB\n", log);
+		failures++;
+	}
+
+	// stats list systems in the order they ran
+	char reported[16] = {0};
+	ecs_pipeline_stats_t stats = {0};
+	ecs_pipeline_stats_get (world, ecs_get_pipeline (world), &stats);
+	ecs_entity_t* stats_systems = ecs_vec_first_t (&stats.systems, ecs_entity_t);
+	for (int i = 0; i < ecs_vec_count (&stats.systems); i++)
+	{
+		for (int s = 0; s < 3; s++)
+		{
+			if (stats_systems[i] == systems[s])
+			{
+				reported[strlen (reported)] = contexts[s].name;
+			}
+		}
+	}
+	ecs_pipeline_stats_fini (&stats);
+
+	if (strcmp (reported, "CAB"))
+	{
+		fprintf (stderr, "check failed: stats report systems as %s, expected CAB\n", reported);
+		failures++;
+	}
+
+	ecs_fini (world);
+
+	return failures;
+}
+
+static int bench_check_deferrals (void)
+{
+	int failures = 0;
+	char log[16] = {0};
+	bench_check_ctx always = {'A', log};
+	bench_check_ctx deferred = {'B', log};
+
+	ecs_world_t* world = ecs_init ();
+
+	// every frame is over a budget this small
+	ecs_entity_t pipeline = ecs_pipeline (world,
+	{
+		.query =
+		{
+			.filter.terms =
+			{
+				{.id = EcsSystem},  // mandatory
+				{.id = EcsPhase, .src.flags = EcsCascade, .src.trav = EcsDependsOn}
+			}
+		},
+		.frame_budget = (ecs_ftime_t) 1e-9
+	});
+	ecs_set_pipeline (world, pipeline);
+
+	ecs_entity_t first_phase = ecs_new_w_id (world, EcsPhase);
+	ecs_entity_t deferred_phase = bench_add_phase (world, first_phase);
+	ecs_set (world, deferred_phase, EcsPhaseSchedule, {.priority_class = 1});
+	bench_check_add_system (world, first_phase, &always);
+	bench_check_add_system (world, deferred_phase, &deferred);
+
+	int deferrals = 0;
+	int deferrals_max = 0;
+	int deferrals_total = 0;
+	for (int i = 0; i < BENCH_CHECK_FRAMES; i++)
+	{
+		memset (log, 0, sizeof (log));
+		ecs_progress (world, 0);
+
+		if (!strcmp (log, "AB"))
+		{
+			deferrals = 0;
+		}
+		else if (!strcmp (log, "A"))
+		{
+			deferrals++;
+			deferrals_total++;
+			deferrals_max = deferrals > deferrals_max ? deferrals : deferrals_max;
+		}
+		else
+		{
+			fprintf (stderr, "check failed: systems ran as %s in frame %d, expected A or AB\n", log, i);
+			failures++;
+		}
+	}
+
+	if (!deferrals_total)
+	{
+		fprintf (stderr, "check failed: phase over budget was never deferred\n");
+		failures++;
+	}
+
+	if (deferrals_max > BENCH_MAX_DEFERRALS)
+	{
+		fprintf (stderr, "check failed: phase was deferred %d frames in a row, expected at most %d\n", deferrals_max, BENCH_MAX_DEFERRALS);
+		failures++;
+	}
+
+	int64_t reported = bench_deferred_count (world, pipeline);
+	if (reported != deferrals_total)
+	{
+		fprintf (stderr, "check failed: stats report %lld deferrals, expected %d\n", (long long) reported, deferrals_total);
+		failures++;
+	}
+
+	ecs_fini (world);
+
+	return failures;
+}
+
+static int bench_check (void)
+{
+	int failures = bench_check_order ();
+	failures += bench_check_deferrals ();
+
+	if (failures)
+	{
+		return 1;
+	}
+
+	printf ("check ok\n");
+	return 0;
+}
+
+static int bench_parse (bench_setup* setup, int argc, char** argv)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (!strcmp (arg, "--parallel"))
+		{
+			setup->parallel = true;
+			continue;
+		}
+
+		if (!strcmp (arg, "--coalesce"))
+		{
+			setup->coalesce = true;
+			continue;
+		}
+
+		if (!strcmp (arg, "--parallel-merge"))
+		{
+			setup->parallel_merge = true;
+			continue;
+		}
+
+		if (!strcmp (arg, "--pin"))
+		{
+			setup->pin = true;
+			continue;
+		}
+
+		if (!value)
+		{
+			fprintf (stderr, "missing value for %s\n", arg);
+			return -1;
+		}
+
+		if (!strcmp (arg, "--phases"))
+		{
+			setup->phases = atoi (value);
+		}
+		else if (!strcmp (arg, "--depth"))
+		{
+			setup->depth = atoi (value);
+		}
+		else if (!strcmp (arg, "--systems"))
+		{
+			setup->systems = atoi (value);
+		}
+		else if (!strcmp (arg, "--overlap"))
+		{
+			setup->overlap = (float) atof (value);
+		}
+		else if (!strcmp (arg, "--threads"))
+		{
+			setup->threads = atoi (value);
+		}
+		else if (!strcmp (arg, "--entities"))
+		{
+			setup->entities = atoi (value);
+		}
+		else if (!strcmp (arg, "--frames"))
+		{
+			setup->frames = atoi (value);
+		}
+		else if (!strcmp (arg, "--chunk"))
+		{
+			setup->chunk = atoi (value);
+		}
+		else if (!strcmp (arg, "--arena"))
+		{
+			setup->arena = atoi (value);
+		}
+		else if (!strcmp (arg, "--budget"))
+		{
+			setup->budget = atoi (value);
+		}
+		else if (!strcmp (arg, "--seed"))
+		{
+			setup->seed = (unsigned int) atoi (value);
+		}
+		else
+		{
+			fprintf (stderr, "unknown option %s\n", arg);
+			return -1;
+		}
+
+		i++;
+	}
+
+	if (setup->phases < 1 || setup->depth < 1 || setup->systems < 1 || setup->threads < 1 || setup->entities < 0 || setup->frames < 1 || setup->chunk < 0 || setup->arena < 0 || setup->budget < 0)
+	{
+		fprintf (stderr, "invalid setup\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+int main (int argc, char** argv)
+{
+	bench_setup setup =
+	{
+		.phases = 8,
+		.depth = 1,
+		.systems = 8,
+		.overlap = 0.1f,
+		.threads = 1,
+		.entities = 1000,
+		.frames = 200,
+		.chunk = 0,
+		.parallel = false,
+		.coalesce = false,
+		.parallel_merge = false,
+		.pin = false,
+		.arena = 0,
+		.budget = 0,
+		.seed = 1
+	};
+
+	if (argc == 2 && !strcmp (argv[1], "--check"))
+	{
+		return bench_check ();
+	}
+
+	if (argc > 1)
+	{
+		if (bench_parse (&setup, argc, argv))
+		{
+			return 1;
+		}
+
+		bench_result result = bench_run (&setup);
+		bench_print (&setup, &result);
+
+		return 0;
+	}
+
+	// default setups
+	// 	scale up pipeline size, merge pressure and threads one at a time
+	const bench_setup setups[] =
+	{
+		{.phases = 8, .depth = 1, .systems = 8, .overlap = 0.0f, .threads = 1, .entities = 1000, .frames = 200},
+		{.phases = 8, .depth = 1, .systems = 8, .overlap = 0.25f, .threads = 1, .entities = 1000, .frames = 200},
+		{.phases = 32, .depth = 4, .systems = 16, .overlap = 0.1f, .threads = 1, .entities = 1000, .frames = 100},
+		{.phases = 8, .depth = 1, .systems = 8, .overlap = 0.1f, .threads = 4, .entities = 2000, .frames = 200},
+		{.phases = 8, .depth = 1, .systems = 8, .overlap = 0.1f, .threads = 4, .entities = 2000, .frames = 200, .chunk = 64},
+		{.phases = 8, .depth = 1, .systems = 8, .overlap = 0.1f, .threads = 4, .entities = 2000, .frames = 200, .parallel = true},
+		{.phases = 8, .depth = 1, .systems = 8, .overlap = 0.25f, .threads = 4, .entities = 2000, .frames = 200, .coalesce = true},
+		{.phases = 8, .depth = 1, .systems = 8, .overlap = 0.25f, .threads = 4, .entities = 2000, .frames = 200, .parallel_merge = true},
+		{.phases = 8, .depth = 1, .systems = 8, .overlap = 0.1f, .threads = 4, .entities = 2000, .frames = 200, .budget = 1000},
+	};
+
+	for (size_t i = 0; i < sizeof (setups) / sizeof (setups[0]); i++)
+	{
+		bench_setup current = setups[i];
+		current.seed = setup.seed;
+		bench_result result = bench_run (&current);
+		bench_print (&current, &result);
+	}
+
+	return 0;
+}